@@ -18,6 +18,7 @@ constexpr const uint32_t inverterID = 0x11002793; /// Identifier of your inverte
 
 AsyncNETSGPClient client(clientSerial, PROG_PIN); // Defaults to fetch status every 2 seconds
 // AsyncNETSGPClient client(clientSerial, PROG_PIN, 10); // Fetch status every 10 seconds
+// BasicAsyncNETSGPClient<32> client(clientSerial, PROG_PIN); // Room for 32 instead of 16 inverters
 
 void onInverterStatus(const AsyncNETSGPClient::InverterStatus& status)
 {
@@ -0,0 +1,1683 @@
+// Benchmark suite for NETSGPClient and AsyncNETSGPClient against a simulated inverter fleet.
+//
+// Simulated time (millis()) models the radio and UART, so throughput numbers like polls per second are reported in
+// simulated time and are deterministic for a given seed. Per call latencies are measured in wall clock time and show
+// the CPU cost of each call on the host.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+
+#include "AsyncNETSGPClient.h"
+#include "Capture.h"
+#include "ChannelSurvey.h"
+#include "EnergyMeter.h"
+#include "EventStream.h"
+#include "ExportController.h"
+#include "FdRxBackend.h"
+#include "FleetManager.h"
+#include "InverterDiscovery.h"
+#include "NETSGPClient.h"
+#include "NoiseTraffic.h"
+#include "SimulatedFleet.h"
+#include "StatusHistory.h"
+
+namespace
+{
+    constexpr const uint8_t PROG_PIN = 4; /// Programming enable pin of the simulated RF module
+    constexpr const uint32_t FIRST_DEVICE_ID = 0x11000001; /// Identifier of the first simulated inverter
+
+    typedef BasicAsyncNETSGPClient<256> BenchAsyncClient; /// Async client large enough for all benchmarks
+
+    /// @brief Benchmark configuration, settable from the command line
+    struct Options
+    {
+        uint32_t inverters = 8;
+        uint32_t durationS = 120;
+        uint32_t loopStepUS = 200;
+        uint8_t maxInFlight = 1;
+        uint8_t radios = 3;
+        uint32_t megabytes = 8; /// Noisy traffic pushed through the decoder by the parser scenario
+        uint32_t seed = 1;
+        std::string scenario = "all";
+        std::string recordPath; /// Save the capture of the capture scenario to this file
+        std::string replayPath; /// Replay this capture file instead of recording one
+        sim::LinkProfile link;
+    };
+
+    /// @brief Wall clock samples of a single call site
+    class CallTimer
+    {
+    public:
+        void start() { mStart = std::chrono::steady_clock::now(); }
+        void stop()
+        {
+            const auto end = std::chrono::steady_clock::now();
+            mSamples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - mStart).count());
+        }
+
+        size_t count() const { return mSamples.size(); }
+
+        void print(const char* name)
+        {
+            if (mSamples.empty())
+            {
+                printf("  %-28s no samples\n", name);
+                return;
+            }
+            std::sort(mSamples.begin(), mSamples.end());
+            double total = 0;
+            for (const int64_t sample : mSamples)
+            {
+                total += sample;
+            }
+            printf("  %-28s calls %9zu  mean %10.0f ns  p50 %9lld ns  p99 %9lld ns  max %9lld ns\n", name,
+                mSamples.size(), total / mSamples.size(), static_cast<long long>(percentile(0.50)),
+                static_cast<long long>(percentile(0.99)), static_cast<long long>(mSamples.back()));
+        }
+
+    private:
+        int64_t percentile(const double p) const
+        {
+            return mSamples[std::min(mSamples.size() - 1, static_cast<size_t>(p * mSamples.size()))];
+        }
+
+    private:
+        std::chrono::steady_clock::time_point mStart;
+        std::vector<int64_t> mSamples;
+    };
+
+    /// @brief Create a fresh simulated clock and fleet
+    void setupFleet(sim::SimulatedLC12S& radio, const Options& options)
+    {
+        radio.setLinkProfile(options.link);
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            radio.addInverter(FIRST_DEVICE_ID + i);
+        }
+    }
+
+    double simSeconds() { return host::nowMicros() / 1e6; }
+
+    void printLink(const sim::SimulatedLC12S& radio)
+    {
+        const sim::Statistics& stats = radio.statistics();
+        printf("  link: requests %u  replies %u  lost %u  corrupted bytes %u\n", stats.requests, stats.replies,
+            stats.lost, stats.corruptedBytes);
+    }
+
+    void printClientStatistics(const NETSGPClient& client)
+    {
+        const NETSGPClient::LinkStatistics stats = client.getStatistics();
+        printf("  client: bytes out %u  in %u  replies %u/%u  timeouts %u  crc errors %u  discarded bytes %u\n",
+            stats.bytesOut, stats.bytesIn, stats.replies, stats.requests, stats.timeouts, stats.crcErrors,
+            stats.discardedBytes);
+        printf("  client: reply latency p50 <= %u ms  p99 <= %u ms  callbacks %u  p99 <= %u us  max %u us\n",
+            stats.replyLatencyMS.percentile(50), stats.replyLatencyMS.percentile(99), stats.callbacks,
+            stats.callbackMicros.percentile(99), stats.callbackMaxMicros);
+    }
+
+    void benchGetStatus(const Options& options)
+    {
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        NETSGPClient client(radio, PROG_PIN);
+
+        CallTimer timer;
+        uint32_t valid = 0;
+        uint32_t invalid = 0;
+        double firstStatusS = -1;
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        while (host::nowMicros() < endUS)
+        {
+            for (uint32_t i = 0; i < options.inverters && host::nowMicros() < endUS; ++i)
+            {
+                timer.start();
+                const NETSGPClient::InverterStatus status = client.getStatus(FIRST_DEVICE_ID + i);
+                timer.stop();
+                if (status.valid)
+                {
+                    ++valid;
+                    if (firstStatusS < 0)
+                    {
+                        firstStatusS = simSeconds();
+                    }
+                }
+                else
+                {
+                    ++invalid;
+                }
+            }
+        }
+
+        printf("NETSGPClient::getStatus()\n");
+        printf("  polls/s %.2f  valid %u  invalid %u  time to first status %.3f s  sim time per call %.1f ms\n",
+            valid / simSeconds(), valid, invalid, firstStatusS, simSeconds() * 1000.0 / (valid + invalid));
+        timer.print("getStatus() wall clock");
+        printLink(radio);
+    }
+
+    /// @brief Exposes the protected validated send for benchmarking
+    class ControlClient : public NETSGPClient
+    {
+    public:
+        using NETSGPClient::Command;
+        using NETSGPClient::NETSGPClient;
+        using NETSGPClient::sendCommandAndValidate;
+    };
+
+    void benchSendCommandAndValidate(const Options& options)
+    {
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        ControlClient client(radio, PROG_PIN);
+
+        CallTimer timer;
+        uint32_t ok = 0;
+        uint32_t failed = 0;
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        uint8_t grade = 0;
+        while (host::nowMicros() < endUS)
+        {
+            for (uint32_t i = 0; i < options.inverters && host::nowMicros() < endUS; ++i)
+            {
+                timer.start();
+                const bool result = client.sendCommandAndValidate(
+                    FIRST_DEVICE_ID + i, ControlClient::Command::POWER_GRADE, grade);
+                timer.stop();
+                result ? ++ok : ++failed;
+            }
+            grade = (grade + 10) % 101;
+        }
+
+        printf("NETSGPClient::sendCommandAndValidate(POWER_GRADE)\n");
+        printf("  commands/s %.2f  ok %u  failed %u  sim time per call %.1f ms\n", ok / simSeconds(), ok, failed,
+            simSeconds() * 1000.0 / (ok + failed));
+        timer.print("sendCommandAndValidate() wall");
+        printLink(radio);
+    }
+
+    uint32_t gAsyncStatusCount = 0; /// Status callbacks received by the async benchmark
+    double gAsyncFirstStatusS = -1; /// Simulated time of the first async status
+
+    void onAsyncStatus(const NETSGPClient::InverterStatus&)
+    {
+        ++gAsyncStatusCount;
+        if (gAsyncFirstStatusS < 0)
+        {
+            gAsyncFirstStatusS = simSeconds();
+        }
+    }
+
+    void benchAsyncUpdate(const Options& options)
+    {
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        BenchAsyncClient client(radio, PROG_PIN, 1);
+        client.setMaxInFlight(options.maxInFlight);
+        client.setStatusCallback(onAsyncStatus);
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            client.registerInverter(FIRST_DEVICE_ID + i);
+        }
+
+        gAsyncStatusCount = 0;
+        gAsyncFirstStatusS = -1;
+        CallTimer timer;
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        while (host::nowMicros() < endUS)
+        {
+            timer.start();
+            client.update();
+            timer.stop();
+            // Time the rest of loop() would take
+            host::advanceMicros(options.loopStepUS);
+        }
+
+        printf("AsyncNETSGPClient::update() (loop step %u us, %u in flight)\n", options.loopStepUS,
+            options.maxInFlight);
+        printf("  polls/s %.2f  statuses %u  time to first status %.3f s  sweep time %.2f s\n",
+            gAsyncStatusCount / simSeconds(), gAsyncStatusCount, gAsyncFirstStatusS,
+            gAsyncStatusCount ? simSeconds() * options.inverters / gAsyncStatusCount : 0.0);
+        timer.print("update() wall clock");
+        printLink(radio);
+        printClientStatistics(client);
+    }
+
+    void benchEventDriven(const Options& options)
+    {
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+
+        // The simulated module sits behind two pipes, the client only sees file descriptors
+        int rxPipe[2];
+        int txPipe[2];
+        if (pipe(rxPipe) != 0 || pipe(txPipe) != 0)
+        {
+            perror("pipe");
+            return;
+        }
+        fcntl(txPipe[0], F_SETFL, O_NONBLOCK);
+        hostio::FdRxBackend backend(rxPipe[0], txPipe[1]);
+        NETSGP::ByteRing<256> ring;
+        NETSGP::EventStream stream(backend, ring);
+        BenchAsyncClient client(stream, PROG_PIN, 1);
+        client.setMaxInFlight(options.maxInFlight);
+        client.setStatusCallback(onAsyncStatus);
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            client.registerInverter(FIRST_DEVICE_ID + i);
+        }
+
+        const auto forwardToRadio = [&]()
+        {
+            uint8_t buffer[256];
+            ssize_t length;
+            while ((length = read(txPipe[0], buffer, sizeof(buffer))) > 0)
+            {
+                radio.write(buffer, length);
+            }
+        };
+
+        gAsyncStatusCount = 0;
+        gAsyncFirstStatusS = -1;
+        CallTimer timer;
+        uint32_t timerWakeups = 0;
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        while (host::nowMicros() < endUS)
+        {
+            // Sleep until the next request is due or the next byte arrives, whatever comes first
+            const uint32_t nextActionMS = client.nextActionMS();
+            uint64_t wakeUS = nextActionMS == BenchAsyncClient::NO_ACTION ? endUS
+                                                                           : host::nowMicros() + nextActionMS * 1000ULL;
+            const uint64_t nextByteUS = radio.nextByteMicros();
+            const bool data = nextByteUS && nextByteUS <= wakeUS;
+            wakeUS = data ? nextByteUS : wakeUS;
+            if (wakeUS > host::nowMicros())
+            {
+                host::advanceMicros(wakeUS - host::nowMicros());
+            }
+            timerWakeups += !data;
+
+            uint8_t byte;
+            while (radio.available() > 0)
+            {
+                byte = radio.read();
+                if (write(rxPipe[1], &byte, 1) != 1)
+                {
+                    perror("write");
+                    return;
+                }
+            }
+            stream.waitForData(0);
+            timer.start();
+            client.update();
+            timer.stop();
+            forwardToRadio();
+        }
+
+        const double polledCalls = options.durationS * 1e6 / options.loopStepUS;
+        printf("AsyncNETSGPClient::update() event driven over pipes (%u in flight)\n", options.maxInFlight);
+        printf("  polls/s %.2f  statuses %u  time to first status %.3f s\n", gAsyncStatusCount / simSeconds(),
+            gAsyncStatusCount, gAsyncFirstStatusS);
+        printf("  wakeups on data %u  on timers %u  update() calls %zu (%.2f%% of polling every %u us)\n",
+            backend.wakeups(), timerWakeups, timer.count(), timer.count() * 100.0 / polledCalls, options.loopStepUS);
+        timer.print("update() wall clock");
+        printLink(radio);
+        for (const int fd : {rxPipe[0], rxPipe[1], txPipe[0], txPipe[1]})
+        {
+            close(fd);
+        }
+    }
+
+    uint32_t gCommandCount[4] = {0}; /// Completed commands per outcome
+    uint32_t gCommandLatencyTotalMS = 0; /// Sum of all successful command latencies
+    uint32_t gCommandLatencyMaxMS = 0; /// Maximum successful command latency
+
+    void onAsyncCommand(const AsyncNETSGPClient::CommandResult& result)
+    {
+        ++gCommandCount[result.outcome];
+        if (result.outcome == AsyncNETSGPClient::COMMAND_SUCCESS)
+        {
+            gCommandLatencyTotalMS += result.latencyMS;
+            gCommandLatencyMaxMS = std::max(gCommandLatencyMaxMS, result.latencyMS);
+        }
+    }
+
+    void benchAsyncCommands(const Options& options)
+    {
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        BenchAsyncClient client(radio, PROG_PIN, 1);
+        client.setMaxInFlight(options.maxInFlight);
+        client.setStatusCallback(onAsyncStatus);
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            client.registerInverter(FIRST_DEVICE_ID + i);
+        }
+
+        gAsyncStatusCount = 0;
+        gAsyncFirstStatusS = -1;
+        memset(gCommandCount, 0, sizeof(gCommandCount));
+        gCommandLatencyTotalMS = 0;
+        gCommandLatencyMaxMS = 0;
+        CallTimer timer;
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        uint64_t nextCommandUS = 0;
+        uint32_t grade = 0;
+        while (host::nowMicros() < endUS)
+        {
+            if (host::nowMicros() >= nextCommandUS)
+            {
+                // Export limiting: change the power grade of one inverter every 500ms
+                nextCommandUS += 500000;
+                grade = (grade + 7) % 101;
+                client.setPowerGradeAsync(FIRST_DEVICE_ID + grade % options.inverters,
+                    static_cast<NETSGPClient::PowerGrade>(grade), onAsyncCommand);
+            }
+            timer.start();
+            client.update();
+            timer.stop();
+            host::advanceMicros(options.loopStepUS);
+        }
+
+        const uint32_t ok = gCommandCount[AsyncNETSGPClient::COMMAND_SUCCESS];
+        printf("AsyncNETSGPClient mixed polling and power grade commands (loop step %u us, %u in flight)\n",
+            options.loopStepUS, options.maxInFlight);
+        printf("  polls/s %.2f  commands ok %u  failed %u  timeout %u  expired %u\n",
+            gAsyncStatusCount / simSeconds(), ok, gCommandCount[AsyncNETSGPClient::COMMAND_FAILED],
+            gCommandCount[AsyncNETSGPClient::COMMAND_TIMEOUT], gCommandCount[AsyncNETSGPClient::COMMAND_EXPIRED]);
+        printf("  command latency mean %.1f ms  max %u ms\n", ok ? static_cast<double>(gCommandLatencyTotalMS) / ok : 0.0,
+            gCommandLatencyMaxMS);
+        timer.print("update() wall clock");
+        printLink(radio);
+    }
+
+    void benchHealth(const Options& options)
+    {
+        // A quarter of the fleet stops answering, e.g. shaded panels or a tripped breaker
+        const uint32_t offline = std::max<uint32_t>(1, options.inverters / 4);
+        printf("AsyncNETSGPClient with %u of %u inverters offline (%u in flight)\n", offline, options.inverters,
+            options.maxInFlight);
+        for (const uint8_t offlineAfter : {0, 4})
+        {
+            host::reset();
+            sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+            setupFleet(radio, options);
+            for (uint32_t i = 0; i < offline; ++i)
+            {
+                radio.inverter(FIRST_DEVICE_ID + i)->online = false;
+            }
+            BenchAsyncClient client(radio, PROG_PIN, 1);
+            client.setMaxInFlight(options.maxInFlight);
+            client.setStatusCallback(onAsyncStatus);
+            AsyncNETSGPClient::HealthPolicy policy;
+            policy.offlineAfter = offlineAfter;
+            client.setHealthPolicy(policy);
+            for (uint32_t i = 0; i < options.inverters; ++i)
+            {
+                client.registerInverter(FIRST_DEVICE_ID + i);
+            }
+
+            gAsyncStatusCount = 0;
+            const uint64_t endUS = options.durationS * 1000000ULL;
+            while (host::nowMicros() < endUS)
+            {
+                client.update();
+                host::advanceMicros(options.loopStepUS);
+            }
+
+            uint32_t offlineRequests = 0;
+            AsyncNETSGPClient::InverterInfo info;
+            for (uint32_t i = 0; i < offline; ++i)
+            {
+                client.getInverterInfo(FIRST_DEVICE_ID + i, info);
+                offlineRequests += info.timeouts;
+            }
+            const uint32_t requests = radio.statistics().requests;
+            printf("  %-22s polls/s of the others %.2f  requests to offline %u/%u (%.1f%%)  offline %zu\n",
+                offlineAfter ? "health policy:" : "always poll all:", gAsyncStatusCount / simSeconds(),
+                offlineRequests, requests, requests ? offlineRequests * 100.0 / requests : 0.0, client.offlineCount());
+        }
+
+        // Queued commands over a lossy link with and without retries
+        for (const uint8_t retries : {0, 2})
+        {
+            host::reset();
+            sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+            sim::LinkProfile link = options.link;
+            link.lossRate = std::max(link.lossRate, 0.3f);
+            setupFleet(radio, options);
+            radio.setLinkProfile(link);
+            BenchAsyncClient client(radio, PROG_PIN, 1);
+            client.setMaxInFlight(options.maxInFlight);
+            AsyncNETSGPClient::HealthPolicy policy;
+            policy.commandRetries = retries;
+            client.setHealthPolicy(policy);
+            for (uint32_t i = 0; i < options.inverters; ++i)
+            {
+                client.registerInverter(FIRST_DEVICE_ID + i);
+            }
+
+            memset(gCommandCount, 0, sizeof(gCommandCount));
+            gCommandLatencyTotalMS = 0;
+            gCommandLatencyMaxMS = 0;
+            const uint64_t endUS = options.durationS * 1000000ULL;
+            uint64_t nextCommandUS = 0;
+            uint32_t grade = 0;
+            uint32_t queued = 0;
+            while (host::nowMicros() < endUS)
+            {
+                if (host::nowMicros() >= nextCommandUS)
+                {
+                    nextCommandUS += 1000000;
+                    grade = (grade + 7) % 101;
+                    queued += client.setPowerGradeAsync(FIRST_DEVICE_ID + grade % options.inverters,
+                        static_cast<NETSGPClient::PowerGrade>(grade), onAsyncCommand);
+                }
+                client.update();
+                host::advanceMicros(options.loopStepUS);
+            }
+
+            const uint32_t ok = gCommandCount[AsyncNETSGPClient::COMMAND_SUCCESS];
+            printf("  retries %u, loss %.2f: commands ok %u/%u (%.1f%%)  timeout %u  latency mean %.1f ms  max %u ms\n",
+                retries, link.lossRate, ok, queued, queued ? ok * 100.0 / queued : 0.0,
+                gCommandCount[AsyncNETSGPClient::COMMAND_TIMEOUT],
+                ok ? static_cast<double>(gCommandLatencyTotalMS) / ok : 0.0, gCommandLatencyMaxMS);
+        }
+    }
+
+    /// @brief Decimal serial number as shown on the label, e.g. 2793 becomes 0x2793
+    uint32_t labelSerial(uint32_t serial)
+    {
+        uint32_t digits = 0;
+        for (uint8_t shift = 0; serial; shift += 4, serial /= 10)
+        {
+            digits |= (serial % 10) << shift;
+        }
+        return digits;
+    }
+
+    void benchDiscovery(const Options& options)
+    {
+        // Inverters of three models with label serials up to 999, the scan covers all known prefixes
+        const uint8_t prefixes[] = {0x11, 0x38, 0x41};
+        std::vector<uint32_t> fleetIDs;
+        for (uint32_t i = 0; fleetIDs.size() < options.inverters && i < 3000; ++i)
+        {
+            const uint32_t deviceID = static_cast<uint32_t>(prefixes[i % 3]) << 24
+                | labelSerial(1 + (i * 2654435761u + options.seed) % 999);
+            if (std::find(fleetIDs.begin(), fleetIDs.end(), deviceID) == fleetIDs.end())
+            {
+                fleetIDs.push_back(deviceID);
+            }
+        }
+        InverterDiscovery::Range ranges[InverterDiscovery::MAX_RANGES];
+        const size_t rangeCount = InverterDiscovery::knownRanges(ranges, InverterDiscovery::MAX_RANGES, 0x999);
+
+        // Blocking reference: one getStatus() per identifier waits the full timeout for every missing inverter
+        double blockingS = 0;
+        {
+            host::reset();
+            sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+            NETSGPClient client(radio, PROG_PIN);
+            client.getStatus(0x11000000);
+            blockingS = simSeconds();
+        }
+
+        printf("InverterDiscovery over %zu known prefixes up to serial 999 (%zu inverters, %u in flight)\n", rangeCount,
+            fleetIDs.size(), options.maxInFlight);
+        printf("  blocking getStatus() per identifier: %.2f s each, %.1f h for the hex range\n", blockingS,
+            blockingS * rangeCount * 0x999 / 3600);
+        for (const bool decimalOnly : {false, true})
+        {
+            for (const bool reboot : {false, true})
+            {
+                host::reset();
+                sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+                radio.setLinkProfile(options.link);
+                for (const uint32_t deviceID : fleetIDs)
+                {
+                    radio.addInverter(deviceID);
+                }
+                std::unique_ptr<BenchAsyncClient> client(new BenchAsyncClient(radio, PROG_PIN, 1));
+                client->setMaxInFlight(options.maxInFlight);
+                client->setStatusCallback(onAsyncStatus);
+                std::unique_ptr<InverterDiscovery> discovery(new InverterDiscovery(*client));
+                InverterDiscovery::Tuning tuning;
+                tuning.decimalOnly = decimalOnly;
+                discovery->setTuning(tuning);
+                discovery->setRanges(ranges, rangeCount);
+                discovery->start();
+
+                gAsyncStatusCount = 0;
+                uint32_t probes = 0;
+                bool rebooted = !reboot;
+                CallTimer timer;
+                while (discovery->scanning())
+                {
+                    if (!rebooted && discovery->probes() * 2 >= rangeCount * 0x999u * (decimalOnly ? 0.4 : 1.0))
+                    {
+                        // Power loss half way: the saved cursor and the registered inverters survive, e.g. in flash
+                        rebooted = true;
+                        const uint32_t cursor = discovery->cursor();
+                        std::vector<uint32_t> known;
+                        AsyncNETSGPClient::InverterInfo info;
+                        for (const uint32_t deviceID : fleetIDs)
+                        {
+                            if (client->getInverterInfo(deviceID, info))
+                            {
+                                known.push_back(deviceID);
+                            }
+                        }
+                        probes += discovery->probes();
+                        discovery.reset();
+                        client.reset(new BenchAsyncClient(radio, PROG_PIN, 1));
+                        client->setMaxInFlight(options.maxInFlight);
+                        client->setStatusCallback(onAsyncStatus);
+                        for (const uint32_t deviceID : known)
+                        {
+                            client->registerInverter(deviceID);
+                        }
+                        discovery.reset(new InverterDiscovery(*client));
+                        discovery->setTuning(tuning);
+                        discovery->setRanges(ranges, rangeCount);
+                        discovery->start(cursor);
+                    }
+                    timer.start();
+                    discovery->update();
+                    timer.stop();
+                    client->update();
+                    host::advanceMicros(options.loopStepUS);
+                }
+                probes += discovery->probes();
+
+                printf("  %-8s %s: probes %u  scan %.1f s  identifiers/s %.1f  registered %zu/%zu  polls/s %.2f\n",
+                    decimalOnly ? "decimal" : "hex", reboot ? "with reboot" : "in one go  ", probes, simSeconds(),
+                    probes / simSeconds(), client->inverterCount(), fleetIDs.size(), gAsyncStatusCount / simSeconds());
+                if (decimalOnly && reboot)
+                {
+                    timer.print("update() wall clock");
+                }
+            }
+        }
+    }
+
+    uint32_t gBatchCount = 0; /// Completed batches
+    uint32_t gBatchSucceeded = 0; /// Successful entries of all batches
+    uint32_t gBatchEntries = 0; /// Entries of all batches
+    uint32_t gBatchTotalMS = 0; /// Sum of all batch durations
+    uint32_t gBatchMaxMS = 0; /// Maximum batch duration
+
+    void onBatch(const AsyncNETSGPClient::BatchResult& result)
+    {
+        ++gBatchCount;
+        gBatchSucceeded += result.succeeded;
+        gBatchEntries += result.count;
+        gBatchTotalMS += result.durationMS;
+        gBatchMaxMS = std::max(gBatchMaxMS, result.durationMS);
+    }
+
+    void benchBatch(const Options& options)
+    {
+        // Blocking reference: curtail the whole fleet once with setPowerGrade()
+        double blockingS = 0;
+        uint32_t blockingOk = 0;
+        {
+            host::reset();
+            sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+            setupFleet(radio, options);
+            ControlClient client(radio, PROG_PIN);
+            const uint64_t startUS = host::nowMicros();
+            for (uint32_t i = 0; i < options.inverters; ++i)
+            {
+                blockingOk += client.setPowerGrade(FIRST_DEVICE_ID + i, NETSGPClient::PG50);
+            }
+            blockingS = (host::nowMicros() - startUS) / 1e6;
+        }
+
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        BenchAsyncClient client(radio, PROG_PIN, 1);
+        client.setMaxInFlight(options.maxInFlight);
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            client.registerInverter(FIRST_DEVICE_ID + i);
+        }
+
+        gBatchCount = 0;
+        gBatchSucceeded = 0;
+        gBatchEntries = 0;
+        gBatchTotalMS = 0;
+        gBatchMaxMS = 0;
+        std::vector<AsyncNETSGPClient::BatchEntry> entries(options.inverters);
+        CallTimer timer;
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        uint64_t nextBatchUS = 0;
+        uint8_t grade = 0;
+        while (host::nowMicros() < endUS)
+        {
+            if (host::nowMicros() >= nextBatchUS && !client.batchRunning())
+            {
+                // Zero export: curtail the whole fleet every 10 s while polling continues
+                nextBatchUS += 10000000;
+                grade = (grade + 37) % 101;
+                const size_t count = client.fillBatch(entries.data(), entries.size(), grade);
+                client.startPowerGradeBatch(entries.data(), count, onBatch);
+            }
+            timer.start();
+            client.update();
+            timer.stop();
+            host::advanceMicros(options.loopStepUS);
+        }
+
+        printf("AsyncNETSGPClient power grade batches over the whole fleet (%u in flight)\n", options.maxInFlight);
+        printf("  blocking setPowerGrade() loop %.2f s  ok %u/%u\n", blockingS, blockingOk, options.inverters);
+        printf("  batches %u  entries ok %u/%u  duration mean %.0f ms  max %u ms\n", gBatchCount, gBatchSucceeded,
+            gBatchEntries, gBatchCount ? static_cast<double>(gBatchTotalMS) / gBatchCount : 0.0, gBatchMaxMS);
+        timer.print("update() wall clock");
+        printLink(radio);
+    }
+
+    void benchExportControl(const Options& options)
+    {
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        BenchAsyncClient client(radio, PROG_PIN, 1);
+        client.setMaxInFlight(options.maxInFlight);
+        BasicExportController<256> controller(client);
+        client.addStatusListener(controller);
+
+        // Inverters of 300W with panels in different sun, so some are limited by the sun and some by the controller
+        const uint16_t ratedW = 300;
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            sim::SimulatedInverter* inverter = radio.inverter(FIRST_DEVICE_ID + i);
+            inverter->ratedPower = ratedW;
+            inverter->dcCurrent = 2.0f + 7.0f * i / std::max(1u, options.inverters - 1);
+            client.registerInverter(FIRST_DEVICE_ID + i);
+            controller.addInverter(FIRST_DEVICE_ID + i, ratedW);
+        }
+        float availableW = 0;
+        for (const sim::SimulatedInverter& inverter : radio.inverters())
+        {
+            availableW += std::min(inverter.dcVoltage * inverter.dcCurrent * 0.95f, inverter.ratedPower);
+        }
+
+        const auto fleetPowerW = [&radio]()
+        {
+            float sum = 0;
+            for (const sim::SimulatedInverter& inverter : radio.inverters())
+            {
+                sum += inverter.acPower();
+            }
+            return sum;
+        };
+
+        CallTimer timer;
+        const int32_t toleranceW = 50;
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        uint64_t nextMeterUS = 0;
+        uint64_t nextLoadUS = 0;
+        uint64_t stepUS = 0;
+        float loadW = 0;
+        double exportWh = 0;
+        double importWh = 0;
+        float maxExportW = 0;
+        uint32_t exportingS = 0;
+        uint32_t loadSteps = 0;
+        uint64_t settleTotalUS = 0;
+        uint32_t settled = 0;
+        bool settling = false;
+        uint32_t random = options.seed;
+        while (host::nowMicros() < endUS)
+        {
+            if (host::nowMicros() >= nextLoadUS)
+            {
+                // House load jumps to a new level between 20% and 80% of what the fleet could deliver every 20 s
+                nextLoadUS += 20000000;
+                random = random * 1103515245 + 12345;
+                loadW = availableW * (0.2f + 0.6f * ((random >> 8) % 1000) / 1000.0f);
+                ++loadSteps;
+                stepUS = host::nowMicros();
+                settling = true;
+            }
+            if (host::nowMicros() >= nextMeterUS)
+            {
+                // Grid meter reading once per second
+                nextMeterUS += 1000000;
+                const float gridW = loadW - fleetPowerW();
+                exportWh += gridW < 0 ? -gridW / 3600.0 : 0.0;
+                importWh += gridW > 0 ? gridW / 3600.0 : 0.0;
+                maxExportW = std::max(maxExportW, -gridW);
+                exportingS += gridW < -toleranceW;
+                if (settling && gridW >= -toleranceW && gridW <= toleranceW + 60)
+                {
+                    settleTotalUS += host::nowMicros() - stepUS;
+                    ++settled;
+                    settling = false;
+                }
+                timer.start();
+                controller.update(static_cast<int32_t>(gridW));
+                timer.stop();
+            }
+            client.update();
+            host::advanceMicros(options.loopStepUS);
+        }
+
+        const ExportControllerBase::ControllerStatistics& stats = controller.statistics();
+        printf("ExportController zero export against load steps (%u in flight, fleet can deliver %.0f W)\n",
+            options.maxInFlight, availableW);
+        printf("  load steps %u  settled %u  mean settle time %.2f s\n", loadSteps, settled,
+            settled ? settleTotalUS / 1e6 / settled : 0.0);
+        printf("  exported %.2f Wh  max export %.0f W  seconds beyond %d W export %u  imported %.2f Wh\n", exportWh,
+            maxExportW, toleranceW, exportingS, importWh);
+        printf("  steps %u  power grade commands %u  failed %u\n", stats.steps, stats.commands, stats.failures);
+        timer.print("update() wall clock");
+        printLink(radio);
+    }
+
+    void benchFleet(const Options& options)
+    {
+        printf("FleetManager sharding over several radios (%u in flight per radio)\n", options.maxInFlight);
+        const uint8_t maxRadios = std::min<uint8_t>(options.radios, FleetManagerBase::MAX_RADIOS);
+        for (uint8_t radioCount = 1; radioCount <= maxRadios; ++radioCount)
+        {
+            host::reset();
+            std::vector<std::unique_ptr<sim::SimulatedLC12S>> radios;
+            std::vector<std::unique_ptr<BenchAsyncClient>> clients;
+            BasicFleetManager<256> fleet;
+            FleetManagerBase::Tuning tuning;
+            tuning.evaluateIntervalMS = 10000;
+            fleet.setTuning(tuning);
+            for (uint8_t r = 0; r < radioCount; ++r)
+            {
+                radios.emplace_back(new sim::SimulatedLC12S(PROG_PIN + r, options.seed + r));
+                setupFleet(*radios.back(), options);
+                clients.emplace_back(new BenchAsyncClient(*radios.back(), PROG_PIN + r, 1));
+                clients.back()->setMaxInFlight(options.maxInFlight);
+                clients.back()->setStatusCallback(onAsyncStatus);
+                fleet.addRadio(*clients.back());
+            }
+            for (uint32_t i = 0; i < options.inverters; ++i)
+            {
+                fleet.addInverter(FIRST_DEVICE_ID + i);
+            }
+
+            gAsyncStatusCount = 0;
+            CallTimer timer;
+            const uint64_t endUS = options.durationS * 1000000ULL;
+            const uint64_t degradeUS = endUS / 2;
+            bool degraded = false;
+            uint32_t firstHalfStatuses = 0;
+            uint32_t movedOff = 0;
+            while (host::nowMicros() < endUS)
+            {
+                if (!degraded && host::nowMicros() >= degradeUS)
+                {
+                    // Half way through radio 0 loses most frames to every other inverter it serves, e.g. a new wall
+                    degraded = true;
+                    firstHalfStatuses = gAsyncStatusCount;
+                    bool degrade = true;
+                    for (uint32_t i = 0; i < options.inverters; ++i)
+                    {
+                        if (fleet.radioOf(FIRST_DEVICE_ID + i) == 0)
+                        {
+                            radios[0]->inverter(FIRST_DEVICE_ID + i)->link.lossRate = degrade ? 0.7f : 0.0f;
+                            movedOff += degrade && radioCount > 1;
+                            degrade = !degrade;
+                        }
+                    }
+                }
+                timer.start();
+                fleet.update();
+                timer.stop();
+                host::advanceMicros(options.loopStepUS);
+            }
+
+            const double halfS = simSeconds() / 2;
+            printf("  radios %u  polls/s first half %.2f  second half %.2f  moves %u (%u links degraded)  load", radioCount,
+                firstHalfStatuses / halfS, (gAsyncStatusCount - firstHalfStatuses) / halfS, fleet.moves(), movedOff);
+            for (uint8_t r = 0; r < radioCount; ++r)
+            {
+                printf(" %zu", fleet.radioLoad(r));
+            }
+            printf("\n");
+            if (radioCount == maxRadios)
+            {
+                timer.print("update() wall clock");
+            }
+        }
+    }
+
+    sim::SimulatedLC12S* gBaudRadio = nullptr; /// Radio whose host UART the baudrate benchmark reconfigures
+
+    void setBenchHostBaudrate(const uint32_t bps) { gBaudRadio->setHostBaudrate(bps); }
+
+    void benchBaudrate(const Options& options)
+    {
+        printf("NETSGPClient::negotiateBaudrate() and polling before and after\n");
+        const LC12S::Baudrate limits[] = {LC12S::BPS_9600, LC12S::BPS_19200, LC12S::BPS_38400};
+        for (const LC12S::Baudrate limit : limits)
+        {
+            host::reset();
+            sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+            setupFleet(radio, options);
+            gBaudRadio = &radio;
+            BenchAsyncClient client(radio, PROG_PIN, 1);
+
+            const uint64_t startUS = host::nowMicros();
+            LC12S::Baudrate baudrate = LC12S::BPS_600;
+            const bool ok = client.negotiateBaudrate(setBenchHostBaudrate, FIRST_DEVICE_ID, baudrate, limit);
+            const double negotiationS = (host::nowMicros() - startUS) / 1e6;
+
+            client.setMaxInFlight(options.maxInFlight);
+            client.setStatusCallback(onAsyncStatus);
+            for (uint32_t i = 0; i < options.inverters; ++i)
+            {
+                client.registerInverter(FIRST_DEVICE_ID + i);
+            }
+            gAsyncStatusCount = 0;
+            const uint64_t pollStartUS = host::nowMicros();
+            const uint64_t endUS = pollStartUS + options.durationS * 1000000ULL;
+            while (host::nowMicros() < endUS)
+            {
+                client.update();
+                host::advanceMicros(options.loopStepUS);
+            }
+
+            // Request and status reply on the wire, 10 bits per byte
+            const double wireMS = 10.0 * (15 + 27) * 1000.0 / LC12S::baudrateToBps(baudrate);
+            printf("  limit %5u baud: %s %5u baud in %.2f s  wire time per poll %.1f ms  polls/s %.2f\n",
+                LC12S::baudrateToBps(limit), ok ? "using" : "FAILED", LC12S::baudrateToBps(baudrate), negotiationS,
+                wireMS, gAsyncStatusCount / ((host::nowMicros() - pollStartUS) / 1e6));
+        }
+
+        // A module that reaches 38400 baud but whose replies get lost at it has to fall back
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        gBaudRadio = &radio;
+        NETSGPClient client(radio, PROG_PIN);
+        for (sim::SimulatedInverter& inverter : radio.inverters())
+        {
+            inverter.online = false;
+        }
+        LC12S::Baudrate baudrate = LC12S::BPS_600;
+        const bool ok = client.negotiateBaudrate(setBenchHostBaudrate, FIRST_DEVICE_ID, baudrate);
+        LC12S::Baudrate detected = LC12S::BPS_600;
+        const bool found = client.detectBaudrate(setBenchHostBaudrate, detected);
+        printf("  unreachable probe inverter: %s, kept %u baud, module at %u baud, detected %s %u baud\n",
+            ok ? "ok" : "FAILED", LC12S::baudrateToBps(baudrate), LC12S::baudrateToBps(radio.moduleSettings().baudrate),
+            found ? "" : "NOT", LC12S::baudrateToBps(detected));
+    }
+
+    bool gConfigDone = false; /// Did the async configuration complete
+    bool gConfigSuccess = false; /// Outcome of the async configuration
+
+    void onConfig(const bool success, const LC12S::Settings&)
+    {
+        gConfigDone = true;
+        gConfigSuccess = success;
+    }
+
+    void benchConfig(const Options& options)
+    {
+        printf("RF module configuration\n");
+        LC12S::Settings changed = LC12S::DEFAULT_SETTINGS;
+        changed.rfPower = LC12S::DBM_10;
+        for (const bool mismatch : {false, true})
+        {
+            host::reset();
+            sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+            setupFleet(radio, options);
+            NETSGPClient client(radio, PROG_PIN);
+            const LC12S::Settings& target = mismatch ? changed : LC12S::DEFAULT_SETTINGS;
+
+            uint64_t startUS = host::nowMicros();
+            const bool first = client.applyRFModuleSettings(target);
+            const double firstMS = (host::nowMicros() - startUS) / 1e3;
+            startUS = host::nowMicros();
+            const bool cached = client.applyRFModuleSettings(target);
+            const double cachedMS = (host::nowMicros() - startUS) / 1e3;
+            printf("  blocking, module %s: first call %s %.1f ms  cached call %s %.1f ms  config frames %u\n",
+                mismatch ? "needs a write" : "already correct", first ? "ok" : "FAILED", firstMS,
+                cached ? "ok" : "FAILED", cachedMS, radio.statistics().configFrames);
+        }
+
+        // Reconfigure while polling, the loop must never stall
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        BenchAsyncClient client(radio, PROG_PIN, 1);
+        client.setMaxInFlight(options.maxInFlight);
+        client.setStatusCallback(onAsyncStatus);
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            client.registerInverter(FIRST_DEVICE_ID + i);
+        }
+        gAsyncStatusCount = 0;
+        gConfigDone = false;
+        gConfigSuccess = false;
+        CallTimer timer;
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        const uint64_t configUS = endUS / 2;
+        uint64_t startUS = 0;
+        uint64_t doneUS = 0;
+        uint64_t longestUS = 0;
+        while (host::nowMicros() < endUS)
+        {
+            if (!startUS && host::nowMicros() >= configUS)
+            {
+                startUS = host::nowMicros();
+                client.applyRFModuleSettingsAsync(changed, onConfig);
+            }
+            const uint64_t callUS = host::nowMicros();
+            timer.start();
+            client.update();
+            timer.stop();
+            longestUS = std::max(longestUS, host::nowMicros() - callUS);
+            if (gConfigDone && !doneUS)
+            {
+                doneUS = host::nowMicros();
+            }
+            host::advanceMicros(options.loopStepUS);
+        }
+        printf("  async while polling: %s after %.1f ms  longest update() %.1f ms simulated  polls/s %.2f  module "
+               "power %s\n",
+            gConfigDone ? (gConfigSuccess ? "ok" : "FAILED") : "NOT DONE", (doneUS - startUS) / 1e3, longestUS / 1e3,
+            gAsyncStatusCount / simSeconds(), radio.moduleSettings().rfPower == changed.rfPower ? "changed" : "UNCHANGED");
+        timer.print("update() wall clock");
+    }
+
+    void benchChannelSurvey(const Options& options)
+    {
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        // Two thirds of the fleet listen on the default channel, the rest on another one
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            radio.inverter(FIRST_DEVICE_ID + i)->rfChannel = i % 3 == 2 ? 0x70 : LC12S::DEFAULT_SETTINGS.rfChannel;
+        }
+        BenchAsyncClient client(radio, PROG_PIN, 1);
+        client.setMaxInFlight(options.maxInFlight);
+        client.setStatusCallback(onAsyncStatus);
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            client.registerInverter(FIRST_DEVICE_ID + i);
+        }
+        // The module lost its settings and sits on a channel no inverter uses
+        LC12S::Settings settings = LC12S::DEFAULT_SETTINGS;
+        settings.rfChannel = 0x40;
+        client.writeRFModuleSettings(settings);
+
+        ChannelSurvey survey(client);
+        const uint8_t channels[] = {0x10, 0x40, LC12S::DEFAULT_SETTINGS.rfChannel, 0x70};
+        survey.setChannels(channels, sizeof(channels));
+        ChannelSurvey::Tuning tuning;
+        tuning.dwellMS = 10000;
+        tuning.checkIntervalMS = 20000;
+        survey.setTuning(tuning);
+
+        gAsyncStatusCount = 0;
+        CallTimer timer;
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        const uint64_t tailUS = endUS - std::min<uint64_t>(endUS / 4, 30000000ULL);
+        uint64_t surveyDoneUS = 0;
+        uint32_t tailStatuses = 0;
+        bool wasSurveying = false;
+        while (host::nowMicros() < endUS)
+        {
+            if (tailUS && host::nowMicros() >= tailUS && !tailStatuses)
+            {
+                tailStatuses = gAsyncStatusCount + 1;
+            }
+            client.update();
+            timer.start();
+            survey.update();
+            timer.stop();
+            if (wasSurveying && !survey.surveying() && !surveyDoneUS)
+            {
+                surveyDoneUS = host::nowMicros();
+            }
+            wasSurveying = survey.surveying();
+            host::advanceMicros(options.loopStepUS);
+        }
+
+        printf("ChannelSurvey recovering from a module on a dead channel (%u in flight)\n", options.maxInFlight);
+        printf("  surveys %u  first done after %.1f s  chosen channel %#x  module channel %#x\n", survey.surveys(),
+            surveyDoneUS / 1e6, survey.channel(), radio.moduleSettings().rfChannel);
+        for (size_t i = 0; i < survey.channelCount(); ++i)
+        {
+            const ChannelSurvey::ChannelResult& result = survey.results()[i];
+            printf("  channel %#04x: %s inverters %u  replies %u  timeouts %u  replies/min %u\n", result.channel,
+                result.measured ? "measured" : "SKIPPED ", result.inverters, result.replies, result.timeouts,
+                result.repliesPerMinute);
+        }
+        const double tailS = (endUS - tailUS) / 1e6;
+        printf("  polls/s over the last %.0f s %.2f\n", tailS, (gAsyncStatusCount + 1 - tailStatuses) / tailS);
+        timer.print("ChannelSurvey::update() wall");
+        printLink(radio);
+    }
+
+    /// @brief Print appending to a byte vector
+    class VectorPrint : public Print
+    {
+    public:
+        size_t write(uint8_t byte) override { return write(&byte, 1); }
+        size_t write(const uint8_t* buffer, size_t size) override
+        {
+            data.insert(data.end(), buffer, buffer + size);
+            return size;
+        }
+        using Print::write;
+
+        std::vector<uint8_t> data;
+    };
+
+    /// @brief Stream reading from a byte vector
+    class VectorStream : public Stream
+    {
+    public:
+        explicit VectorStream(const std::vector<uint8_t>& data) : mData(data) { }
+
+        int available() override { return mData.size() - mPosition; }
+        int read() override { return mPosition < mData.size() ? mData[mPosition++] : -1; }
+        int peek() override { return mPosition < mData.size() ? mData[mPosition] : -1; }
+        size_t write(uint8_t) override { return 0; }
+        using Print::write;
+
+    private:
+        const std::vector<uint8_t>& mData;
+        size_t mPosition = 0;
+    };
+
+    /// @brief Parse all received bytes of a capture as fast as possible
+    void parseCapture(const std::vector<uint8_t>& capture)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        VectorStream source(capture);
+        NETSGP::ReplayStream replay(source, 0);
+        NETSGP::FrameParser parser;
+        uint32_t frames[3] = {0};
+        while (!replay.finished())
+        {
+            if (parser.feed(replay))
+            {
+                ++frames[parser.command() == NETSGPClient::Command::STATUS ? 0 : 1];
+            }
+            else if (!replay.available())
+            {
+                break;
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("  parsed %s capture: status frames %u  command frames %u  crc errors %u  discarded bytes %u\n",
+            replay.valid() ? "valid" : "INVALID", frames[0], frames[1], parser.crcErrors(), parser.discardedBytes());
+        printf("  received bytes %u  sent bytes %u  wall %.3f ms  %.0f frames/s\n", replay.playedBytes(),
+            replay.recordedSentBytes(), seconds * 1e3, (frames[0] + frames[1]) / seconds);
+    }
+
+    void benchCapture(const Options& options)
+    {
+        printf("CaptureStream and ReplayStream (%u in flight)\n", options.maxInFlight);
+        std::vector<uint8_t> capture;
+        if (!options.replayPath.empty())
+        {
+            FILE* file = fopen(options.replayPath.c_str(), "rb");
+            if (!file)
+            {
+                perror(options.replayPath.c_str());
+                return;
+            }
+            int byte;
+            while ((byte = fgetc(file)) != EOF)
+            {
+                capture.push_back(byte);
+            }
+            fclose(file);
+            parseCapture(capture);
+            return;
+        }
+
+        // Record polling and power grade commands
+        uint32_t recordedStatuses = 0;
+        {
+            host::reset();
+            sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+            setupFleet(radio, options);
+            VectorPrint log;
+            NETSGP::CaptureStream tap(radio, log);
+            tap.begin();
+            BenchAsyncClient client(tap, PROG_PIN, 1);
+            client.setMaxInFlight(options.maxInFlight);
+            client.setStatusCallback(onAsyncStatus);
+            for (uint32_t i = 0; i < options.inverters; ++i)
+            {
+                client.registerInverter(FIRST_DEVICE_ID + i);
+            }
+            gAsyncStatusCount = 0;
+            CallTimer timer;
+            const uint64_t endUS = options.durationS * 1000000ULL;
+            uint64_t nextCommandUS = 0;
+            uint32_t grade = 0;
+            while (host::nowMicros() < endUS)
+            {
+                if (host::nowMicros() >= nextCommandUS)
+                {
+                    nextCommandUS += 5000000;
+                    grade = (grade + 7) % 101;
+                    client.setPowerGradeAsync(FIRST_DEVICE_ID + grade % options.inverters,
+                        static_cast<NETSGPClient::PowerGrade>(grade));
+                }
+                timer.start();
+                client.update();
+                timer.stop();
+                host::advanceMicros(options.loopStepUS);
+            }
+            tap.end();
+            capture = log.data;
+            recordedStatuses = gAsyncStatusCount;
+            const NETSGPClient::LinkStatistics stats = client.getStatistics();
+            printf("  recorded %zu bytes in %u records for %u bytes on the link (%.1f%% overhead)\n", capture.size(),
+                tap.records(), stats.bytesIn + stats.bytesOut,
+                100.0 * capture.size() / (stats.bytesIn + stats.bytesOut) - 100.0);
+            timer.print("update() wall with capture");
+        }
+
+        if (!options.recordPath.empty())
+        {
+            FILE* file = fopen(options.recordPath.c_str(), "wb");
+            if (!file || fwrite(capture.data(), 1, capture.size(), file) != capture.size())
+            {
+                perror(options.recordPath.c_str());
+            }
+            if (file)
+            {
+                fclose(file);
+            }
+        }
+
+        // The same client schedule against the replayed capture has to see the same statuses at the same time
+        for (const float speed : {1.0f, 4.0f})
+        {
+            host::reset();
+            VectorStream source(capture);
+            NETSGP::ReplayStream replay(source, speed);
+            replay.begin();
+            BenchAsyncClient client(replay, PROG_PIN, 1);
+            client.setMaxInFlight(options.maxInFlight);
+            client.setStatusCallback(onAsyncStatus);
+            for (uint32_t i = 0; i < options.inverters; ++i)
+            {
+                client.registerInverter(FIRST_DEVICE_ID + i);
+            }
+            gAsyncStatusCount = 0;
+            const uint64_t endUS = options.durationS * 1000000ULL / speed;
+            uint64_t nextCommandUS = 0;
+            uint32_t grade = 0;
+            while (host::nowMicros() < endUS)
+            {
+                if (host::nowMicros() >= nextCommandUS)
+                {
+                    nextCommandUS += 5000000 / speed;
+                    grade = (grade + 7) % 101;
+                    client.setPowerGradeAsync(FIRST_DEVICE_ID + grade % options.inverters,
+                        static_cast<NETSGPClient::PowerGrade>(grade));
+                }
+                client.update();
+                host::advanceMicros(options.loopStepUS);
+            }
+            printf("  replay at %.0fx: statuses %u of %u recorded  client sent %u of %u recorded bytes  %s\n", speed,
+                gAsyncStatusCount, recordedStatuses, replay.writtenBytes(), replay.recordedSentBytes(),
+                replay.finished() ? "finished" : "NOT FINISHED");
+        }
+        parseCapture(capture);
+    }
+
+    /// @brief Client exposing the reply decoder, fed from a byte vector
+    class DecodeClient : public NETSGPClient
+    {
+    public:
+        explicit DecodeClient(Stream& stream) : NETSGPClient(stream, PROG_PIN) { }
+
+        /// @brief Decode all replies like the synchronous client does
+        ///
+        /// @param statuses Valid STATUS replies
+        /// @return uint32_t All replies
+        uint32_t decodeAll(uint32_t& statuses)
+        {
+            uint32_t frames = 0;
+            while (readReply())
+            {
+                ++frames;
+                InverterStatus status;
+                if (mBuffer[1] == Command::STATUS && fillInverterStatusFromBuffer(&mBuffer[0], status))
+                {
+                    ++statuses;
+                }
+            }
+            return frames;
+        }
+    };
+
+    void benchParser(const Options& options)
+    {
+        std::vector<uint8_t> traffic;
+        const sim::TrafficMix mix;
+        const sim::TrafficStatistics generated
+            = sim::generateTraffic(traffic, options.megabytes * 1024 * 1024, mix, options.seed);
+        printf("Reply decoder on %.1f MB of noisy traffic\n", traffic.size() / 1048576.0);
+        printf("  generated %u valid frames (%u STATUS, %u altered behind the checksum), %u corrupted, %u truncated, "
+               "%u garbage bytes\n",
+            generated.validFrames, generated.statusFrames, generated.alteredFrames, generated.corruptedFrames,
+            generated.truncatedFrames, generated.garbageBytes);
+
+        const auto report = [&](const char* name, const uint32_t frames, const uint32_t statuses, const double seconds,
+                                const uint32_t crcErrors, const uint32_t discardedBytes) {
+            printf("  %-20s %8u frames %8u STATUS  %9.0f frames/s  %6.2f ns/byte  %7.1f MB/s\n", name, frames,
+                statuses, frames / seconds, seconds * 1e9 / traffic.size(), traffic.size() / seconds / 1048576.0);
+            printf("  %-20s crc errors %u  discarded bytes %u  found %u frames for %u valid ones\n", "", crcErrors,
+                discardedBytes, frames, generated.validFrames);
+        };
+
+        // The parser alone, one byte at a time
+        {
+            NETSGP::FrameParser parser;
+            uint32_t frames = 0;
+            uint32_t statuses = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (const uint8_t byte : traffic)
+            {
+                if (parser.feed(byte))
+                {
+                    ++frames;
+                    statuses += parser.command() == NETSGPClient::Command::STATUS;
+                }
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            report("FrameParser::feed()", frames, statuses, seconds, parser.crcErrors(), parser.discardedBytes());
+        }
+
+        // The client path including the Stream calls, the copy into mBuffer and the status decoding
+        {
+            VectorStream stream(traffic);
+            DecodeClient client(stream);
+            uint32_t statuses = 0;
+            const auto start = std::chrono::steady_clock::now();
+            const uint32_t frames = client.decodeAll(statuses);
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const NETSGPClient::LinkStatistics stats = client.getStatistics();
+            report("readReply()", frames, statuses, seconds, stats.crcErrors, stats.discardedBytes);
+        }
+        printf("  Frames beyond the valid ones are garbage passing the checksum by chance, netsgp_fuzz checks that\n"
+               "  no valid frame is lost\n");
+    }
+
+    void benchHistory(const Options& options)
+    {
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        BenchAsyncClient client(radio, PROG_PIN, 1);
+        client.setMaxInFlight(options.maxInFlight);
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            client.registerInverter(FIRST_DEVICE_ID + i);
+        }
+
+        /// @brief Times every status added to the history
+        class TimedHistory : public NETSGP::StatusListener
+        {
+        public:
+            void onStatus(const NETSGP::CompactStatus& status, const uint32_t timeMS) override
+            {
+                timer.start();
+                history.onStatus(status, timeMS);
+                timer.stop();
+            }
+
+            NETSGP::StatusHistory<64> history;
+            CallTimer timer;
+        };
+        static TimedHistory timed;
+        timed.history.clear();
+        client.addStatusListener(timed);
+
+        const uint64_t endUS = options.durationS * 1000000ULL;
+        while (host::nowMicros() < endUS)
+        {
+            client.update();
+            host::advanceMicros(options.loopStepUS);
+        }
+
+        size_t points = 0;
+        CallTimer queryTimer;
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            for (const NETSGP::HistoryTier tier : {NETSGP::TIER_RAW, NETSGP::TIER_MINUTE, NETSGP::TIER_QUARTER})
+            {
+                queryTimer.start();
+                for (const NETSGP::HistoryPoint& point : timed.history.query(FIRST_DEVICE_ID + i, tier))
+                {
+                    points += point.samples > 0;
+                }
+                queryTimer.stop();
+            }
+        }
+
+        printf("NETSGP::StatusHistory (%zu bytes per inverter)\n", NETSGP::StatusHistory<64>::BYTES_PER_INVERTER);
+        printf("  inverters %zu  points with data %zu\n", timed.history.inverterCount(), points);
+        timed.timer.print("onStatus() wall clock");
+        queryTimer.print("query() full tier wall");
+    }
+
+    void benchEnergy(const Options& options)
+    {
+        host::reset();
+        sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+        setupFleet(radio, options);
+        BenchAsyncClient client(radio, PROG_PIN, 1);
+        client.setMaxInFlight(options.maxInFlight);
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            client.registerInverter(FIRST_DEVICE_ID + i);
+        }
+
+        /// @brief Times every status added to the meter
+        class TimedMeter : public NETSGP::StatusListener
+        {
+        public:
+            void onStatus(const NETSGP::CompactStatus& status, const uint32_t timeMS) override
+            {
+                timer.start();
+                meter.onStatus(status, timeMS);
+                timer.stop();
+            }
+
+            NETSGP::EnergyMeter<64> meter;
+            CallTimer timer;
+        };
+        static TimedMeter reconciled;
+        static NETSGP::EnergyMeter<64> integrated;
+        reconciled.meter.clear();
+        integrated.clear();
+        NETSGP::EnergyMeter<64>::Settings settings;
+        settings.counterMWh = 0;
+        integrated.setSettings(settings);
+        client.addStatusListener(reconciled);
+        client.addStatusListener(integrated);
+
+        // One day from sunrise to sunset with passing clouds. The counter of each inverter counts in 0.01 kWh steps,
+        // the radio link is down for 20 minutes and the first inverter reboots in the afternoon.
+        constexpr const uint64_t DAY_US = 12 * 3600 * 1000000ULL;
+        constexpr const uint32_t STEP_US = 5000;
+        const uint64_t outageUS = DAY_US / 3;
+        const uint64_t rebootUS = DAY_US * 7 / 12;
+        std::vector<double> truthKWh(options.inverters, 0.0);
+        std::vector<double> counterKWh(options.inverters, 123.45);
+        std::mt19937 random(options.seed);
+        std::uniform_real_distribution<float> cloud(0.5f, 1.0f);
+        float shade = 1.0f;
+        uint64_t nextCloudUS = 0;
+        bool rebooted = false;
+        while (host::nowMicros() < DAY_US)
+        {
+            const uint64_t nowUS = host::nowMicros();
+            if (nowUS >= nextCloudUS)
+            {
+                nextCloudUS += 45000000;
+                shade = cloud(random);
+            }
+            const bool online = nowUS < outageUS || nowUS >= outageUS + 20 * 60 * 1000000ULL;
+            if (!rebooted && nowUS >= rebootUS)
+            {
+                rebooted = true;
+                counterKWh[0] = 0.0;
+            }
+            const float sun = static_cast<float>(sin(3.14159265 * nowUS / DAY_US));
+            for (uint32_t i = 0; i < options.inverters; ++i)
+            {
+                sim::SimulatedInverter& inverter = *radio.inverter(FIRST_DEVICE_ID + i);
+                inverter.online = online;
+                inverter.dcCurrent = 18.0f * sun * shade * (1.0f - 0.02f * (i % 8));
+                const double kWh = inverter.acPower() * (STEP_US / 3.6e12);
+                truthKWh[i] += kWh;
+                counterKWh[i] += kWh;
+                inverter.totalGeneratedPower = static_cast<float>(static_cast<uint32_t>(counterKWh[i] * 100) / 100.0);
+            }
+            client.update();
+            host::advanceMicros(STEP_US);
+        }
+        reconciled.meter.rollDay();
+        integrated.rollDay();
+
+        double truthTotal = 0;
+        double worstIntegrated = 0;
+        double worstReconciled = 0;
+        NETSGP::InverterEnergy energy = {};
+        NETSGP::InverterEnergy diagnostics = {};
+        for (uint32_t i = 0; i < options.inverters; ++i)
+        {
+            const double truthMWh = truthKWh[i] * 1e6;
+            truthTotal += truthMWh;
+            integrated.energy(FIRST_DEVICE_ID + i, energy);
+            worstIntegrated = std::max(worstIntegrated, fabs(energy.totals.previousDayMWh - truthMWh) / truthMWh);
+            reconciled.meter.energy(FIRST_DEVICE_ID + i, energy);
+            worstReconciled = std::max(worstReconciled, fabs(energy.totals.previousDayMWh - truthMWh) / truthMWh);
+            diagnostics.correctionMWh += energy.correctionMWh;
+            diagnostics.gapMWh += energy.gapMWh;
+            diagnostics.gaps += energy.gaps;
+            diagnostics.counterResets += energy.counterResets;
+            diagnostics.rejected += energy.rejected;
+        }
+
+        const double integratedTotal = static_cast<double>(integrated.fleet().previousDayMWh);
+        const double reconciledTotal = static_cast<double>(reconciled.meter.fleet().previousDayMWh);
+        printf("NETSGP::EnergyMeter over a 12 h day with clouds, a 20 min outage and a reboot (%zu bytes for 64)\n",
+            sizeof(NETSGP::EnergyMeter<64>));
+        printf("  true fleet energy %.3f kWh\n", truthTotal / 1e6);
+        printf("  integration only: %.3f kWh  fleet error %+.2f%%  worst inverter %.2f%%\n", integratedTotal / 1e6,
+            (integratedTotal - truthTotal) * 100 / truthTotal, worstIntegrated * 100);
+        printf("  reconciled:       %.3f kWh  fleet error %+.2f%%  worst inverter %.2f%%\n", reconciledTotal / 1e6,
+            (reconciledTotal - truthTotal) * 100 / truthTotal, worstReconciled * 100);
+        printf("  corrections %+.3f kWh  gaps %u bridged with %.3f kWh  counter resets %u  rejected windows %u\n",
+            diagnostics.correctionMWh / 1e6, diagnostics.gaps, diagnostics.gapMWh / 1e6, diagnostics.counterResets,
+            diagnostics.rejected);
+        reconciled.timer.print("onStatus() wall clock");
+        client.removeStatusListener(reconciled);
+        client.removeStatusListener(integrated);
+    }
+
+    void usage(const char* name)
+    {
+        printf("Usage: %s [options]\n"
+               "  --scenario NAME   all, status, control, async, event, commands, health, discovery,\n"
+               "                    batch, export, fleet, baud, config, channel, capture,\n"
+               "                    parser, history or energy (default all)\n"
+               "  --inverters N     number of simulated inverters (default 8)\n"
+               "  --duration S      simulated seconds per scenario (default 120)\n"
+               "  --latency MS      mean reply latency (default 60)\n"
+               "  --jitter MS       reply latency jitter (default 20)\n"
+               "  --loss P          request/reply loss probability 0-1 (default 0)\n"
+               "  --corrupt P       per byte corruption probability 0-1 (default 0)\n"
+               "  --loop-step US    simulated loop() time between update() calls (default 200)\n"
+               "  --in-flight K     outstanding async requests, pipelining if above 1 (default 1)\n"
+               "  --radios R        fleet scenario runs with 1 to R radios (default 3)\n"
+               "  --megabytes M     noisy traffic decoded by the parser scenario (default 8)\n"
+               "  --seed N          random seed (default 1)\n"
+               "  --record FILE     save the capture of the capture scenario\n"
+               "  --replay FILE     parse this capture in the capture scenario instead\n",
+            name);
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--scenario")
+        {
+            options.scenario = value;
+        }
+        else if (arg == "--inverters")
+        {
+            options.inverters = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--duration")
+        {
+            options.durationS = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--latency")
+        {
+            options.link.latencyUS = strtoul(value, nullptr, 0) * 1000;
+        }
+        else if (arg == "--jitter")
+        {
+            options.link.jitterUS = strtoul(value, nullptr, 0) * 1000;
+        }
+        else if (arg == "--loss")
+        {
+            options.link.lossRate = strtof(value, nullptr);
+        }
+        else if (arg == "--corrupt")
+        {
+            options.link.corruptRate = strtof(value, nullptr);
+        }
+        else if (arg == "--loop-step")
+        {
+            options.loopStepUS = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--in-flight")
+        {
+            options.maxInFlight = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--radios")
+        {
+            options.radios = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--record")
+        {
+            options.recordPath = value;
+        }
+        else if (arg == "--replay")
+        {
+            options.replayPath = value;
+        }
+        else if (arg == "--megabytes")
+        {
+            options.megabytes = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--seed")
+        {
+            options.seed = strtoul(value, nullptr, 0);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    printf("%u inverters, %u s simulated, latency %u ms +- %u ms, loss %.3f, corruption %.4f\n\n", options.inverters,
+        options.durationS, options.link.latencyUS / 1000, options.link.jitterUS / 1000, options.link.lossRate,
+        options.link.corruptRate);
+
+    const bool all = options.scenario == "all";
+    if (all || options.scenario == "status")
+    {
+        benchGetStatus(options);
+    }
+    if (all || options.scenario == "control")
+    {
+        benchSendCommandAndValidate(options);
+    }
+    if (all || options.scenario == "async")
+    {
+        benchAsyncUpdate(options);
+    }
+    if (all || options.scenario == "event")
+    {
+        benchEventDriven(options);
+    }
+    if (all || options.scenario == "commands")
+    {
+        benchAsyncCommands(options);
+    }
+    if (all || options.scenario == "health")
+    {
+        benchHealth(options);
+    }
+    if (all || options.scenario == "discovery")
+    {
+        benchDiscovery(options);
+    }
+    if (all || options.scenario == "batch")
+    {
+        benchBatch(options);
+    }
+    if (all || options.scenario == "export")
+    {
+        benchExportControl(options);
+    }
+    if (all || options.scenario == "fleet")
+    {
+        benchFleet(options);
+    }
+    if (all || options.scenario == "baud")
+    {
+        benchBaudrate(options);
+    }
+    if (all || options.scenario == "config")
+    {
+        benchConfig(options);
+    }
+    if (all || options.scenario == "channel")
+    {
+        benchChannelSurvey(options);
+    }
+    if (all || options.scenario == "capture")
+    {
+        benchCapture(options);
+    }
+    if (all || options.scenario == "parser")
+    {
+        benchParser(options);
+    }
+    if (all || options.scenario == "history")
+    {
+        benchHistory(options);
+    }
+    if (all || options.scenario == "energy")
+    {
+        benchEnergy(options);
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <atomic>
+
+#include "Arduino.h"
+
+namespace
+{
+    std::atomic<uint64_t> gMicros {0};
+    std::atomic<uint32_t> gYieldStepUS {50};
+    std::atomic<uint8_t> gPins[256];
+} // namespace
+
+uint32_t millis()
+{
+    return static_cast<uint32_t>(gMicros.load() / 1000);
+}
+
+uint32_t micros()
+{
+    return static_cast<uint32_t>(gMicros.load());
+}
+
+void delay(uint32_t ms)
+{
+    gMicros += static_cast<uint64_t>(ms) * 1000;
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    gMicros += us;
+}
+
+void yield()
+{
+    gMicros += gYieldStepUS.load();
+}
+
+void pinMode(uint8_t, uint8_t) { }
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    gPins[pin] = value ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return gPins[pin];
+}
+
+namespace host
+{
+    uint64_t nowMicros() { return gMicros.load(); }
+
+    void advanceMicros(const uint64_t us) { gMicros += us; }
+
+    void reset()
+    {
+        gMicros = 0;
+        for (std::atomic<uint8_t>& pin : gPins)
+        {
+            pin = LOW;
+        }
+    }
+
+    void setYieldStepMicros(const uint32_t us) { gYieldStepUS = us; }
+} // namespace host
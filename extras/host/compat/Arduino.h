@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+#include <stdlib.h>
+
+#include "Print.h"
+#include "Stream.h"
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+/// @brief Host only helpers to drive the simulated clock
+namespace host
+{
+    /// @brief Current simulated time in microseconds
+    uint64_t nowMicros();
+
+    /// @brief Advance the simulated clock
+    ///
+    /// @param us Microseconds to advance
+    void advanceMicros(const uint64_t us);
+
+    /// @brief Reset the simulated clock and all pin states
+    void reset();
+
+    /// @brief Set how far each yield() advances the simulated clock, default is 50us
+    ///
+    /// @param us Microseconds per yield()
+    void setYieldStepMicros(const uint32_t us);
+} // namespace host
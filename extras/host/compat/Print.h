@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// @brief Minimal host stand-in for the Arduino Print class
+class Print
+{
+public:
+    virtual ~Print() { }
+
+    virtual size_t write(uint8_t byte) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t n = 0;
+        while (size--)
+        {
+            if (!write(*buffer++))
+            {
+                break;
+            }
+            ++n;
+        }
+        return n;
+    }
+    size_t write(const char* str) { return str ? write(reinterpret_cast<const uint8_t*>(str), strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write(reinterpret_cast<const uint8_t*>(buffer), size); }
+
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() { }
+
+    size_t print(const char* str) { return write(str); }
+    size_t println(const char* str = "") { return write(str) + write("\r\n"); }
+};
@@ -0,0 +1,61 @@
+#include "Stream.h"
+
+#include "Arduino.h"
+
+int Stream::timedRead()
+{
+    const uint32_t startMillis = millis();
+    do
+    {
+        const int c = read();
+        if (c >= 0)
+        {
+            return c;
+        }
+        yield();
+    } while (millis() - startMillis < mTimeout);
+    return -1;
+}
+
+bool Stream::find(const char* target, size_t length)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+
+    size_t index = 0;
+    int c;
+    while ((c = timedRead()) >= 0)
+    {
+        if (static_cast<char>(c) == target[index])
+        {
+            if (++index >= length)
+            {
+                return true;
+            }
+        }
+        else
+        {
+            // Restart the match, the current byte may be the start of a new match
+            index = static_cast<char>(c) == target[0] ? 1 : 0;
+        }
+    }
+    return false;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length)
+    {
+        const int c = timedRead();
+        if (c < 0)
+        {
+            break;
+        }
+        *buffer++ = static_cast<char>(c);
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Print.h"
+
+/// @brief Minimal host stand-in for the Arduino Stream class.
+///
+/// Timed reads spin on yield(), which advances the simulated clock, so blocking calls like find() and readBytes()
+/// behave like on the target but finish instantly in wall clock time.
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { mTimeout = timeout; }
+    unsigned long getTimeout() const { return mTimeout; }
+
+    bool find(const char* target, size_t length);
+    bool find(const uint8_t* target, size_t length) { return find(reinterpret_cast<const char*>(target), length); }
+
+    size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes(reinterpret_cast<char*>(buffer), length); }
+
+protected:
+    /// @brief Read a byte or return -1 after mTimeout milliseconds
+    int timedRead();
+
+protected:
+    unsigned long mTimeout = 1000; /// Timeout for timed reads in milliseconds
+};
@@ -0,0 +1,288 @@
+// Fuzz harness for the reply decoder, the only code touching untrusted radio bytes. Every input is fed in chunks
+// through NETSGPClient::readReply() and fillInverterStatusFromBuffer() and checked against a byte by byte reference
+// scan: every frame has to fit mBuffer and no valid frame may be lost or invented by a desync. Decoded statuses also
+// pass through a small NETSGP::StatusRing, which has to hold exactly the newest ones of the reference in order.
+//
+// Configure with -DNETSGP_LIBFUZZER=ON (clang) for a libFuzzer binary. Otherwise this is a standalone driver that runs
+// the given files, e.g. a corpus or AFL's @@, or random noisy traffic with --random. -DNETSGP_ASAN=ON adds
+// AddressSanitizer and UndefinedBehaviorSanitizer to either.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "NETSGPClient.h"
+#include "NoiseTraffic.h"
+#include "StatusFrame.h"
+
+namespace
+{
+    /// @brief Stream handing out a buffer in chunks, as if the bytes arrived over time
+    class ChunkedStream : public Stream
+    {
+    public:
+        ChunkedStream(const uint8_t* data, const size_t size) : mData(data), mSize(size) { }
+
+        /// @brief Make more bytes available
+        void release(const size_t bytes) { mLimit = mLimit + bytes < mSize ? mLimit + bytes : mSize; }
+
+        /// @brief Were all bytes made available
+        bool released() const { return mLimit == mSize; }
+
+        int available() override { return mLimit - mPosition; }
+        int read() override { return mPosition < mLimit ? mData[mPosition++] : -1; }
+        int peek() override { return mPosition < mLimit ? mData[mPosition] : -1; }
+        size_t write(uint8_t) override { return 1; }
+        using Print::write;
+
+    private:
+        const uint8_t* mData; /// Bytes to hand out
+        size_t mSize; /// Amount of bytes
+        size_t mLimit = 0; /// Bytes made available so far
+        size_t mPosition = 0; /// Bytes read so far
+    };
+
+    /// @brief Client exposing the decoder internals to the harness
+    class FuzzClient : public NETSGPClient
+    {
+    public:
+        explicit FuzzClient(Stream& stream) : NETSGPClient(stream, 4) { }
+
+        using NETSGPClient::BUFFER_SIZE;
+        using NETSGPClient::fillInverterStatusFromBuffer;
+        using NETSGPClient::readReply;
+
+        const uint8_t* buffer() const { return &mBuffer[0]; }
+        uint8_t frameLength() const { return mParser.length(); }
+    };
+
+    /// @brief Frame found by the reference scan
+    struct ReferenceFrame
+    {
+        size_t offset;
+        uint8_t length;
+    };
+
+    /// @brief Reference scan written without the codec or the parser: take the frame at the first position that holds
+    /// a complete valid one, continue right after it, otherwise one byte later
+    std::vector<ReferenceFrame> referenceScan(const std::vector<uint8_t>& data)
+    {
+        std::vector<ReferenceFrame> frames;
+        size_t offset = 0;
+        while (offset + 2 <= data.size())
+        {
+            const uint8_t command = data[offset + 1];
+            const uint8_t length = command == 0xC0 ? 27 : (command == 0xC1 || command == 0xC3 ? 15 : 0);
+            if (data[offset] == 0x43 && length && offset + length <= data.size())
+            {
+                uint8_t sum = 0;
+                for (size_t i = 0; i < 14; ++i)
+                {
+                    sum += data[offset + i];
+                }
+                if (sum == data[offset + 14])
+                {
+                    frames.push_back({offset, length});
+                    offset += length;
+                    continue;
+                }
+            }
+            ++offset;
+        }
+        return frames;
+    }
+
+    /// @brief Ring capacity small enough that most inputs wrap it
+    constexpr size_t RING_CAPACITY = 4;
+
+    /// @brief Check that the ring holds the newest STATUS frames of the reference, oldest first
+    ///
+    /// @param ring Ring every decoded status was pushed into with its frame number as time
+    /// @param input Scanned bytes
+    /// @param expected Frames found by the reference scan
+    bool ringMatches(const NETSGP::StatusRing<RING_CAPACITY>& ring, const std::vector<uint8_t>& input,
+        const std::vector<ReferenceFrame>& expected)
+    {
+        std::vector<size_t> statusFrames;
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            if (input[expected[i].offset + 1] == 0xC0)
+            {
+                statusFrames.push_back(i);
+            }
+        }
+        const size_t newest = statusFrames.size() < RING_CAPACITY ? statusFrames.size() : RING_CAPACITY;
+        if (ring.size() != newest)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < newest; ++i)
+        {
+            const size_t frame = statusFrames[statusFrames.size() - newest + i];
+            const NETSGP::CompactStatus reference = NETSGP::StatusFrame(&input[expected[frame].offset]).compact();
+            const NETSGP::StatusRing<RING_CAPACITY>::Entry& entry = ring[i];
+            if (entry.timeMS != frame || entry.status.deviceID != reference.deviceID
+                || entry.status.totalGeneratedPowerBits != reference.totalGeneratedPowerBits
+                || entry.status.dcVoltage != reference.dcVoltage || entry.status.acCurrent != reference.acCurrent
+                || entry.status.temperature != reference.temperature)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void fail(const char* reason, const size_t frame)
+    {
+        fprintf(stderr, "netsgp_fuzz: %s at frame %zu\n", reason, frame);
+        abort();
+    }
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    // The first byte selects how many bytes arrive at once, the padding completes a frame cut off at the end, so the
+    // parser has to decide on it like the reference scan does
+    const size_t chunk = 1 + data[0] % 64;
+    std::vector<uint8_t> input(data + 1, data + size);
+    input.insert(input.end(), NETSGP::FrameParser::MAX_FRAME_SIZE, 0x00);
+    const std::vector<ReferenceFrame> expected = referenceScan(input);
+
+    ChunkedStream stream(input.data(), input.size());
+    FuzzClient client(stream);
+    NETSGP::StatusRing<RING_CAPACITY> ring;
+    size_t frames = 0;
+    while (true)
+    {
+        while (client.readReply())
+        {
+            if (client.frameLength() > FuzzClient::BUFFER_SIZE)
+            {
+                fail("frame larger than mBuffer", frames);
+            }
+            if (frames >= expected.size())
+            {
+                fail("invented frame", frames);
+            }
+            const ReferenceFrame& reference = expected[frames];
+            if (client.frameLength() != reference.length
+                || memcmp(client.buffer(), &input[reference.offset], reference.length) != 0)
+            {
+                fail("desync, frame differs from the reference", frames);
+            }
+            if (client.buffer()[1] == NETSGPClient::Command::STATUS)
+            {
+                NETSGPClient::InverterStatus status;
+                if (!client.fillInverterStatusFromBuffer(client.buffer(), status))
+                {
+                    fail("parsed STATUS reply does not decode", frames);
+                }
+                ring.push(NETSGP::StatusFrame(client.buffer()).compact(), static_cast<uint32_t>(frames));
+            }
+            ++frames;
+        }
+        if (stream.released())
+        {
+            break;
+        }
+        stream.release(chunk);
+    }
+    if (frames != expected.size())
+    {
+        fail("lost frame", frames);
+    }
+    if (!ringMatches(ring, input, expected))
+    {
+        fail("status ring differs from the newest reference statuses", frames);
+    }
+    return 0;
+}
+
+#ifndef NETSGP_LIBFUZZER
+namespace
+{
+    void usage(const char* name)
+    {
+        printf("Usage: %s [options] [FILE...]\n"
+               "  FILE              run one input, e.g. from a corpus or AFL's @@\n"
+               "  --random N        run N inputs of random noisy traffic (default 10000 without files)\n"
+               "  --seed N          random seed (default 1)\n",
+            name);
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t randomInputs = 0;
+    uint32_t seed = 1;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--random" && i + 1 < argc)
+        {
+            randomInputs = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = strtoul(argv[++i], nullptr, 0);
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty() && randomInputs == 0)
+    {
+        randomInputs = 10000;
+    }
+
+    for (const std::string& file : files)
+    {
+        FILE* input = fopen(file.c_str(), "rb");
+        if (!input)
+        {
+            perror(file.c_str());
+            return 1;
+        }
+        std::vector<uint8_t> data;
+        int byte;
+        while ((byte = fgetc(input)) != EOF)
+        {
+            data.push_back(byte);
+        }
+        fclose(input);
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+
+    // Mostly broken traffic, so resyncs and frames hidden inside broken ones are common
+    sim::TrafficMix mix;
+    mix.corruptRate = 0.3f;
+    mix.truncateRate = 0.3f;
+    mix.garbageRate = 0.5f;
+    mix.magicRate = 0.5f;
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < randomInputs; ++i)
+    {
+        std::vector<uint8_t> data(1, static_cast<uint8_t>(seed + i));
+        sim::generateTraffic(data, 1 + (seed + i) * 2654435761u % 512, mix, seed + i);
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+        bytes += data.size();
+    }
+
+    printf("%zu files and %u random inputs (%zu bytes) passed\n", files.size(), randomInputs, bytes);
+    return 0;
+}
+#endif
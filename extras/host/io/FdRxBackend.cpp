@@ -0,0 +1,103 @@
+#include "FdRxBackend.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace hostio
+{
+    size_t FdRxBackend::write(const uint8_t* data, const size_t length)
+    {
+        size_t written = 0;
+        while (written < length)
+        {
+            const ssize_t result = ::write(mTxFd, data + written, length - written);
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                break;
+            }
+            written += result;
+        }
+        return written;
+    }
+
+    bool FdRxBackend::receive(NETSGP::ByteRingBase& ring, const uint32_t timeoutMS)
+    {
+        pollfd descriptor = {mRxFd, POLLIN, 0};
+        const int ready = ::poll(&descriptor, 1, ring.empty() ? static_cast<int>(timeoutMS) : 0);
+        if (ready > 0 && (descriptor.revents & POLLIN))
+        {
+            ++mWakeups;
+            uint8_t buffer[256];
+            const size_t space = ring.capacity() - ring.size();
+            const ssize_t result = ::read(mRxFd, buffer, space < sizeof(buffer) ? space : sizeof(buffer));
+            if (result > 0)
+            {
+                ring.push(buffer, result);
+            }
+        }
+        return !ring.empty();
+    }
+
+    int FdRxBackend::openSerial(const char* path, const uint32_t baudrate)
+    {
+        speed_t speed;
+        switch (baudrate)
+        {
+        case 600:
+            speed = B600;
+            break;
+        case 1200:
+            speed = B1200;
+            break;
+        case 2400:
+            speed = B2400;
+            break;
+        case 4800:
+            speed = B4800;
+            break;
+        case 9600:
+            speed = B9600;
+            break;
+        case 19200:
+            speed = B19200;
+            break;
+        case 38400:
+            speed = B38400;
+            break;
+        default:
+            return -1;
+        }
+
+        const int fd = ::open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        termios options;
+        if (tcgetattr(fd, &options) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        cfmakeraw(&options);
+        cfsetispeed(&options, speed);
+        cfsetospeed(&options, speed);
+        options.c_cflag |= CLOCAL | CREAD;
+        options.c_cc[VMIN] = 0;
+        options.c_cc[VTIME] = 0;
+        if (tcsetattr(fd, TCSANOW, &options) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+} // namespace hostio
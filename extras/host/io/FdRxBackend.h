@@ -0,0 +1,39 @@
+#pragma once
+
+#include <EventStream.h>
+
+/// @brief Host (Linux) I/O backends
+namespace hostio
+{
+    /// @brief RxBackend on POSIX file descriptors, waits for received bytes with poll().
+    ///
+    /// Works with serial ports (see openSerial()), pipes and sockets. The receive and transmit descriptors may be the
+    /// same one.
+    class FdRxBackend : public NETSGP::RxBackend
+    {
+    public:
+        /// @brief Construct a new FdRxBackend object, the descriptors are not closed on destruction
+        ///
+        /// @param rxFd Descriptor bytes from the RF module are read from
+        /// @param txFd Descriptor bytes to the RF module are written to
+        FdRxBackend(const int rxFd, const int txFd) : mRxFd(rxFd), mTxFd(txFd) { }
+
+        size_t write(const uint8_t* data, const size_t length) override;
+        bool receive(NETSGP::ByteRingBase& ring, const uint32_t timeoutMS) override;
+
+        /// @brief Amount of poll() calls that returned because data arrived
+        uint32_t wakeups() const { return mWakeups; }
+
+        /// @brief Open a serial port in raw 8N1 mode
+        ///
+        /// @param path Path of the serial port, e.g. /dev/ttyUSB0
+        /// @param baudrate Baudrate in bits per second
+        /// @return int Descriptor or -1 on error
+        static int openSerial(const char* path, const uint32_t baudrate);
+
+    private:
+        int mRxFd; /// Descriptor bytes are read from
+        int mTxFd; /// Descriptor bytes are written to
+        uint32_t mWakeups = 0; /// poll() calls that returned with data
+    };
+} // namespace hostio
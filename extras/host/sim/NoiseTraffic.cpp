@@ -0,0 +1,80 @@
+#include "NoiseTraffic.h"
+
+#include <random>
+
+#include "FrameCodec.h"
+#include "StatusFrame.h"
+
+namespace sim
+{
+    TrafficStatistics generateTraffic(
+        std::vector<uint8_t>& traffic, const size_t bytes, const TrafficMix& mix, const uint32_t seed)
+    {
+        typedef NETSGP::Codec::CommandFrame CommandFrame;
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+        TrafficStatistics statistics;
+        const size_t end = traffic.size() + bytes;
+        uint8_t frame[NETSGP::StatusFrame::SIZE];
+
+        while (traffic.size() < end)
+        {
+            if (chance(random) < mix.garbageRate)
+            {
+                const uint32_t length = 1 + random() % mix.maxGarbage;
+                for (uint32_t i = 0; i < length; ++i)
+                {
+                    traffic.push_back(chance(random) < mix.magicRate ? CommandFrame::MAGIC : random() & 0xFF);
+                }
+                statistics.garbageBytes += length;
+            }
+
+            size_t length;
+            const bool status = chance(random) < mix.statusRate;
+            if (status)
+            {
+                NETSGP::CompactStatus compact;
+                compact.deviceID = 0x11000000 | (random() & 0xFFFF);
+                compact.totalGeneratedPowerBits = random();
+                compact.dcVoltage = random() % 6000;
+                compact.dcCurrent = random() % 1500;
+                compact.acVoltage = 22000 + random() % 2000;
+                compact.acCurrent = random() % 300;
+                compact.state = random() & 0xFF;
+                compact.temperature = random() % 90;
+                NETSGP::StatusFrame::encode(compact, frame);
+                length = NETSGP::StatusFrame::SIZE;
+            }
+            else
+            {
+                const bool control = random() & 1;
+                CommandFrame::encode(frame, control ? 0xC1 : 0xC3, 0x11000000 | (random() & 0xFFFF),
+                    control ? 1 + random() % 3 : random() % 101);
+                length = CommandFrame::SIZE;
+            }
+
+            bool valid = true;
+            if (chance(random) < mix.corruptRate)
+            {
+                // STATUS replies carry values behind the checksum, a flip there goes unnoticed
+                const size_t offset = random() % length;
+                frame[offset] ^= 1 << (random() % 8);
+                valid = offset > CommandFrame::CHECKSUM_OFFSET;
+                ++(valid ? statistics.alteredFrames : statistics.corruptedFrames);
+            }
+            else if (chance(random) < mix.truncateRate)
+            {
+                length = 1 + random() % (length - 1);
+                valid = false;
+                ++statistics.truncatedFrames;
+            }
+            if (valid)
+            {
+                ++statistics.validFrames;
+                statistics.statusFrames += status;
+            }
+            traffic.insert(traffic.end(), frame, frame + length);
+        }
+        return statistics;
+    }
+} // namespace sim
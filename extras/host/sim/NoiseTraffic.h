@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/// @brief Host side simulation of an LC12S RF module and a fleet of NETSGP inverters
+namespace sim
+{
+    /// @brief Composition of generated reply traffic, all rates are per frame
+    struct TrafficMix
+    {
+        float statusRate = 0.8f; /// Share of STATUS replies, the rest are CONTROL and POWER_GRADE replies
+        float corruptRate = 0.1f; /// Probability that a frame gets a random bit flipped
+        float truncateRate = 0.05f; /// Probability that a frame is cut off at a random length
+        float garbageRate = 0.2f; /// Probability of a burst of random bytes in front of a frame
+        uint8_t maxGarbage = 24; /// Maximum length of a garbage burst
+        float magicRate = 0.25f; /// Share of garbage bytes that are the magic byte, making the parser resync a lot
+    };
+
+    /// @brief What went into generated traffic
+    struct TrafficStatistics
+    {
+        uint32_t validFrames = 0; /// Frames passing the checksum
+        uint32_t statusFrames = 0; /// Valid STATUS replies
+        uint32_t corruptedFrames = 0; /// Frames failing the checksum due to a flipped bit
+        uint32_t alteredFrames = 0; /// Valid frames with a flipped bit behind the checksum
+        uint32_t truncatedFrames = 0; /// Frames cut off
+        uint32_t garbageBytes = 0; /// Random bytes between frames
+    };
+
+    /// @brief Append reply traffic of a noisy 2.4 GHz band as the host UART would receive it
+    ///
+    /// @param traffic Destination, bytes are appended
+    /// @param bytes Amount of bytes to append at least
+    /// @param mix Composition of the traffic
+    /// @param seed Random seed, the same seed gives the same traffic
+    /// @return TrafficStatistics What went into the traffic
+    TrafficStatistics generateTraffic(
+        std::vector<uint8_t>& traffic, const size_t bytes, const TrafficMix& mix, const uint32_t seed);
+} // namespace sim
@@ -0,0 +1,338 @@
+#include "SimulatedFleet.h"
+
+#include <algorithm>
+
+#include <Arduino.h>
+
+namespace sim
+{
+    namespace
+    {
+        constexpr const uint8_t MAGIC_BYTE = 0x43;
+        constexpr const size_t REQUEST_SIZE = 15;
+        constexpr const size_t STATUS_REPLY_SIZE = 27;
+        constexpr const size_t CONFIG_SIZE = 18;
+
+        uint8_t sum(const uint8_t* data, const size_t bytes)
+        {
+            uint8_t crc = 0;
+            for (size_t i = 0; i < bytes; ++i)
+            {
+                crc += data[i];
+            }
+            return crc;
+        }
+
+        void writeU16(uint8_t* data, const float value)
+        {
+            const uint16_t fixed = static_cast<uint16_t>(std::max(0.0f, value * 100.0f + 0.5f));
+            data[0] = fixed >> 8;
+            data[1] = fixed & 0xFF;
+        }
+    } // namespace
+
+    float SimulatedInverter::acPower() const
+    {
+        if (!active)
+        {
+            return 0.0f;
+        }
+        const float available = dcVoltage * dcCurrent * 0.95f;
+        return std::min(available, ratedPower * powerGrade / 100.0f);
+    }
+
+    SimulatedLC12S::SimulatedLC12S(const uint8_t progPin, const uint32_t seed)
+        : mProgPin(progPin), mSettings(LC12S::DEFAULT_SETTINGS), mRandom(seed)
+    { }
+
+    SimulatedInverter& SimulatedLC12S::addInverter(const uint32_t deviceID)
+    {
+        mInverters.emplace_back();
+        SimulatedInverter& inverter = mInverters.back();
+        inverter.deviceID = deviceID;
+        inverter.link = mDefaultLink;
+        return inverter;
+    }
+
+    SimulatedInverter* SimulatedLC12S::inverter(const uint32_t deviceID)
+    {
+        for (SimulatedInverter& inverter : mInverters)
+        {
+            if (inverter.deviceID == deviceID)
+            {
+                return &inverter;
+            }
+        }
+        return nullptr;
+    }
+
+    void SimulatedLC12S::setLinkProfile(const LinkProfile& profile)
+    {
+        mDefaultLink = profile;
+        for (SimulatedInverter& inverter : mInverters)
+        {
+            inverter.link = profile;
+        }
+    }
+
+    uint32_t SimulatedLC12S::baudrateToBps(const LC12S::Baudrate baudrate)
+    {
+        return 600UL << baudrate;
+    }
+
+    int SimulatedLC12S::available()
+    {
+        const uint64_t now = host::nowMicros();
+        int count = 0;
+        for (const TimedByte& b : mRX)
+        {
+            if (b.time > now)
+            {
+                break;
+            }
+            ++count;
+        }
+        return count;
+    }
+
+    int SimulatedLC12S::read()
+    {
+        if (mRX.empty() || mRX.front().time > host::nowMicros())
+        {
+            return -1;
+        }
+        const uint8_t byte = mRX.front().byte;
+        mRX.pop_front();
+        return byte;
+    }
+
+    int SimulatedLC12S::peek()
+    {
+        if (mRX.empty() || mRX.front().time > host::nowMicros())
+        {
+            return -1;
+        }
+        return mRX.front().byte;
+    }
+
+    size_t SimulatedLC12S::write(uint8_t byte)
+    {
+        return write(&byte, 1);
+    }
+
+    size_t SimulatedLC12S::write(const uint8_t* buffer, size_t size)
+    {
+        const uint64_t byteTime = byteTimeUS();
+        const bool baudMismatch = mHostBaudrate != baudrateToBps(mSettings.baudrate);
+        for (size_t i = 0; i < size; ++i)
+        {
+            mTXBusyUntil = std::max(mTXBusyUntil, host::nowMicros()) + byteTime;
+            if (baudMismatch)
+            {
+                // Module cannot decode anything sent at the wrong baudrate
+                continue;
+            }
+            mTX.push_back(buffer[i]);
+
+            if (programming())
+            {
+                if (mTX.front() != 0xAA)
+                {
+                    mTX.erase(mTX.begin());
+                }
+                else if (mTX.size() == CONFIG_SIZE)
+                {
+                    handleConfigFrame(mTXBusyUntil);
+                    mTX.clear();
+                }
+            }
+            else
+            {
+                if (mTX.front() != MAGIC_BYTE)
+                {
+                    mTX.erase(mTX.begin());
+                }
+                else if (mTX.size() == REQUEST_SIZE)
+                {
+                    handleRadioFrame(mTXBusyUntil);
+                    mTX.clear();
+                }
+            }
+        }
+        return size;
+    }
+
+    uint64_t SimulatedLC12S::byteTimeUS() const
+    {
+        // 8N1 needs 10 bits per byte
+        return (10ULL * 1000000ULL + mHostBaudrate - 1) / mHostBaudrate;
+    }
+
+    bool SimulatedLC12S::programming() const
+    {
+        return digitalRead(mProgPin) == LOW;
+    }
+
+    void SimulatedLC12S::handleRadioFrame(const uint64_t receivedUS)
+    {
+        const uint8_t* request = mTX.data();
+        if (request[14] != sum(request, 14))
+        {
+            return;
+        }
+        ++mStatistics.requests;
+
+        const uint32_t deviceID = static_cast<uint32_t>(request[6]) << 24 | static_cast<uint32_t>(request[7]) << 16
+            | static_cast<uint32_t>(request[8]) << 8 | request[9];
+        SimulatedInverter* target = inverter(deviceID);
+        if (!target || !target->online || target->rfChannel != mSettings.rfChannel
+            || target->networkID != mSettings.networkID)
+        {
+            return;
+        }
+
+        if (random() < target->link.lossRate)
+        {
+            ++mStatistics.lost;
+            return;
+        }
+
+        uint8_t reply[STATUS_REPLY_SIZE];
+        const size_t length = buildReply(*target, request, reply);
+        if (!length)
+        {
+            return;
+        }
+
+        const int64_t jitter = target->link.jitterUS
+            ? static_cast<int64_t>(random() * 2 * target->link.jitterUS) - target->link.jitterUS
+            : 0;
+        const int64_t latency = std::max<int64_t>(0, static_cast<int64_t>(target->link.latencyUS) + jitter);
+        queueReply(reply, length, receivedUS + latency, target->link.corruptRate);
+        ++mStatistics.replies;
+    }
+
+    void SimulatedLC12S::handleConfigFrame(const uint64_t receivedUS)
+    {
+        uint8_t* frame = mTX.data();
+        if (frame[17] != sum(frame, 17))
+        {
+            return;
+        }
+        ++mStatistics.configFrames;
+
+        uint8_t reply[CONFIG_SIZE] = {0};
+        if (frame[1] == 0x5C)
+        {
+            reply[1] = 0x5D;
+        }
+        else if (frame[1] == 0x5A)
+        {
+            reply[1] = 0x5B;
+            mSettings.moduleID = frame[2] << 8 | frame[3];
+            mSettings.networkID = frame[4] << 8 | frame[5];
+            mSettings.rfPower = static_cast<LC12S::RFPower>(frame[7]);
+            mSettings.baudrate = static_cast<LC12S::Baudrate>(frame[9]);
+            mSettings.rfChannel = frame[11];
+        }
+        else
+        {
+            return;
+        }
+
+        reply[0] = 0xAA;
+        reply[2] = mSettings.moduleID >> 8;
+        reply[3] = mSettings.moduleID & 0xFF;
+        reply[4] = mSettings.networkID >> 8;
+        reply[5] = mSettings.networkID & 0xFF;
+        reply[7] = mSettings.rfPower;
+        reply[9] = mSettings.baudrate;
+        reply[11] = mSettings.rfChannel;
+        reply[15] = 0x12;
+        reply[17] = sum(reply, 17);
+        // The module answers quickly after processing the frame
+        queueReply(reply, CONFIG_SIZE, receivedUS + 2000, 0.0f);
+    }
+
+    size_t SimulatedLC12S::buildReply(SimulatedInverter& inverter, const uint8_t* request, uint8_t* reply)
+    {
+        const uint8_t command = request[1];
+        const uint8_t value = request[13];
+        switch (command)
+        {
+        case 0xC0:
+        {
+            memset(reply, 0, STATUS_REPLY_SIZE);
+            memcpy(reply, request, 10);
+
+            uint32_t total;
+            memcpy(&total, &inverter.totalGeneratedPower, sizeof(total));
+            reply[10] = total >> 24;
+            reply[11] = (total >> 16) & 0xFF;
+            reply[12] = (total >> 8) & 0xFF;
+            reply[13] = total & 0xFF;
+            reply[14] = sum(reply, 14);
+
+            const float acPower = inverter.acPower();
+            const float dcCurrent = inverter.active ? acPower / 0.95f / inverter.dcVoltage : 0.0f;
+            writeU16(&reply[15], inverter.dcVoltage);
+            writeU16(&reply[17], dcCurrent);
+            writeU16(&reply[19], inverter.acVoltage);
+            writeU16(&reply[21], acPower / inverter.acVoltage);
+            reply[25] = inverter.state;
+            reply[26] = inverter.temperature;
+            return STATUS_REPLY_SIZE;
+        }
+        case 0xC1:
+            if (value == 0x01 || value == 0x02)
+            {
+                inverter.active = value == 0x01;
+            }
+            else if (value == 0x03)
+            {
+                ++inverter.reboots;
+            }
+            else
+            {
+                return 0;
+            }
+            break;
+        case 0xC3:
+            if (value > 100)
+            {
+                return 0;
+            }
+            inverter.powerGrade = value;
+            break;
+        default:
+            return 0;
+        }
+
+        memcpy(reply, request, REQUEST_SIZE);
+        reply[14] = sum(reply, 14);
+        return REQUEST_SIZE;
+    }
+
+    void SimulatedLC12S::queueReply(const uint8_t* data, const size_t length, uint64_t startUS, const float corruptRate)
+    {
+        const uint64_t byteTime = byteTimeUS();
+        startUS = std::max(startUS, mRXBusyUntil);
+        for (size_t i = 0; i < length; ++i)
+        {
+            uint8_t byte = data[i];
+            if (corruptRate > 0.0f && random() < corruptRate)
+            {
+                byte ^= 1 << (mRandom() % 8);
+                ++mStatistics.corruptedBytes;
+            }
+            startUS += byteTime;
+            mRX.push_back({startUS, byte});
+        }
+        mRXBusyUntil = startUS;
+    }
+
+    float SimulatedLC12S::random()
+    {
+        return std::uniform_real_distribution<float>(0.0f, 1.0f)(mRandom);
+    }
+} // namespace sim
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <Stream.h>
+
+#include "NETSGPClient.h"
+
+/// @brief Host side simulation of an LC12S RF module and a fleet of NETSGP inverters
+namespace sim
+{
+    /// @brief Behaviour of the radio link between the RF module and one inverter
+    struct LinkProfile
+    {
+        uint32_t latencyUS = 60000; /// Mean time from received request to first reply byte
+        uint32_t jitterUS = 20000; /// Uniform jitter applied to latencyUS in both directions
+        float lossRate = 0.0f; /// Probability that a request or its reply gets lost
+        float corruptRate = 0.0f; /// Probability per reply byte to get a random bit flipped
+    };
+
+    /// @brief Electrical state and behaviour of one simulated inverter
+    struct SimulatedInverter
+    {
+        uint32_t deviceID; /// Unique inverter identifier
+        uint8_t rfChannel = LC12S::DEFAULT_SETTINGS.rfChannel; /// RF channel the inverter listens on
+        uint16_t networkID = LC12S::DEFAULT_SETTINGS.networkID; /// Network identifier the inverter listens on
+        bool online = true; /// Does the inverter answer at all (false at night)
+        LinkProfile link; /// Radio link to this inverter
+
+        uint8_t state = 0x01; /// Reported state byte
+        uint8_t temperature = 35; /// Reported temperature byte
+        float totalGeneratedPower = 123.45f; /// Reported total generated power counter
+        float dcVoltage = 32.5f; /// Panel voltage in Volts
+        float dcCurrent = 6.2f; /// Panel current in Amperes
+        float acVoltage = 230.0f; /// Grid voltage in Volts
+        float ratedPower = 600.0f; /// Maximum AC power in Watts
+        uint8_t powerGrade = 100; /// Power grade in percent
+        bool active = true; /// Activated (true) or deactivated (false)
+        uint32_t reboots = 0; /// Number of received reboot commands
+
+        /// @brief AC power the inverter currently feeds in Watts
+        float acPower() const;
+    };
+
+    /// @brief Counters of the simulated link
+    struct Statistics
+    {
+        uint32_t requests = 0; /// Complete request frames received from the host
+        uint32_t replies = 0; /// Reply frames sent to the host
+        uint32_t lost = 0; /// Requests or replies that were dropped
+        uint32_t corruptedBytes = 0; /// Reply bytes with a flipped bit
+        uint32_t configFrames = 0; /// RF module configuration frames received in programming mode
+    };
+
+    /// @brief Simulated LC12S RF module including all inverters in range, seen from the host UART.
+    ///
+    /// All timing follows the simulated clock of the host compatibility layer (millis()/micros()). Bytes written to
+    /// this stream are serialized at the host baudrate, inverters reply after their link latency and reply bytes
+    /// become available once they would have arrived on the UART.
+    class SimulatedLC12S : public Stream
+    {
+    public:
+        /// @brief Construct a new simulated RF module
+        ///
+        /// @param progPin Programming enable pin of the RF module (active low)
+        /// @param seed Seed for latency jitter, loss and corruption
+        SimulatedLC12S(const uint8_t progPin, const uint32_t seed = 1);
+
+        /// @brief Add an inverter in range of this module
+        ///
+        /// @param deviceID Unique inverter identifier
+        /// @return SimulatedInverter& The new inverter using the default link profile
+        SimulatedInverter& addInverter(const uint32_t deviceID);
+
+        /// @brief Find a simulated inverter
+        ///
+        /// @param deviceID Unique inverter identifier
+        /// @return SimulatedInverter* Inverter or nullptr if not present
+        SimulatedInverter* inverter(const uint32_t deviceID);
+
+        /// @brief All simulated inverters
+        std::deque<SimulatedInverter>& inverters() { return mInverters; }
+
+        /// @brief Set the link profile used for new inverters and apply it to all present ones
+        void setLinkProfile(const LinkProfile& profile);
+
+        /// @brief Set the baudrate the host UART is configured to
+        void setHostBaudrate(const uint32_t baudrate) { mHostBaudrate = baudrate; }
+
+        /// @brief Current settings of the simulated module
+        const LC12S::Settings& moduleSettings() const { return mSettings; }
+
+        /// @brief Counters of the simulated link
+        const Statistics& statistics() const { return mStatistics; }
+
+        /// @brief Simulated time in microseconds at which the next byte becomes available, 0 if none is pending
+        uint64_t nextByteMicros() const { return mRX.empty() ? 0 : mRX.front().time; }
+
+        /// @brief Convert a LC12S baudrate setting to bits per second
+        static uint32_t baudrateToBps(const LC12S::Baudrate baudrate);
+
+        int available() override;
+        int read() override;
+        int peek() override;
+        size_t write(uint8_t byte) override;
+        size_t write(const uint8_t* buffer, size_t size) override;
+        using Print::write;
+
+    private:
+        /// @brief A byte on its way to the host and the simulated time it arrives
+        struct TimedByte
+        {
+            uint64_t time;
+            uint8_t byte;
+        };
+
+        /// @brief Microseconds one UART byte (8N1) takes at the current host baudrate
+        uint64_t byteTimeUS() const;
+
+        /// @brief Is the module in programming mode
+        bool programming() const;
+
+        /// @brief Handle a complete transparent mode frame
+        void handleRadioFrame(const uint64_t receivedUS);
+
+        /// @brief Handle a complete programming mode frame
+        void handleConfigFrame(const uint64_t receivedUS);
+
+        /// @brief Build the reply of an inverter into reply
+        size_t buildReply(SimulatedInverter& inverter, const uint8_t* request, uint8_t* reply);
+
+        /// @brief Queue bytes for the host starting no earlier than startUS
+        void queueReply(const uint8_t* data, const size_t length, uint64_t startUS, const float corruptRate);
+
+        /// @brief Draw a uniform random number in [0, 1)
+        float random();
+
+    private:
+        uint8_t mProgPin; /// Programming enable pin (active low)
+        uint32_t mHostBaudrate = 9600; /// Baudrate of the host UART
+        LC12S::Settings mSettings; /// Current module settings
+        LinkProfile mDefaultLink; /// Link profile for new inverters
+        std::deque<SimulatedInverter> mInverters; /// All inverters in range
+        std::deque<TimedByte> mRX; /// Bytes on their way to the host
+        std::vector<uint8_t> mTX; /// Bytes received from the host not yet forming a frame
+        uint64_t mTXBusyUntil = 0; /// Time the host UART finishes sending
+        uint64_t mRXBusyUntil = 0; /// Time the module UART finishes sending
+        Statistics mStatistics; /// Link counters
+        std::mt19937 mRandom; /// Random source
+    };
+} // namespace sim
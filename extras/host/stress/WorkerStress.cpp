@@ -0,0 +1,204 @@
+// Stress test of RadioWorker: one radio thread runs the async client against the simulated fleet while several
+// consumer threads submit requests and check their results. Build with -DNETSGP_TSAN=ON to run it under
+// ThreadSanitizer.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+
+#include "AsyncNETSGPClient.h"
+#include "RadioWorker.h"
+#include "SimulatedFleet.h"
+
+namespace
+{
+    constexpr const uint8_t PROG_PIN = 4; /// Programming enable pin of the simulated RF module
+    constexpr const uint32_t FIRST_DEVICE_ID = 0x11000001; /// Identifier of the first simulated inverter
+
+    /// @brief Stress configuration, settable from the command line
+    struct Options
+    {
+        uint32_t inverters = 8;
+        uint32_t consumers = 3;
+        uint32_t requests = 500;
+        uint8_t maxInFlight = 2;
+        float loss = 0.02f;
+        uint32_t seed = 1;
+    };
+
+    /// @brief Outcome of one consumer thread
+    struct ConsumerReport
+    {
+        uint32_t succeeded = 0;
+        uint32_t failed = 0;
+        uint32_t errors = 0;
+    };
+
+    void consume(RadioWorker::Channel& channel, const Options& options, const uint32_t index, ConsumerReport& report)
+    {
+        uint32_t random = options.seed * 7919 + index;
+        std::vector<bool> open(options.requests, false);
+        uint32_t submitted = 0;
+        uint32_t completed = 0;
+        while (completed < options.requests)
+        {
+            if (submitted < options.requests)
+            {
+                random = random * 1103515245 + 12345;
+                RadioWorker::WorkerRequest request;
+                request.type = static_cast<RadioWorker::RequestType>((random >> 8) % 3 == 0
+                        ? RadioWorker::REQUEST_POWER_GRADE
+                        : ((random >> 8) % 3 == 1 ? RadioWorker::REQUEST_STATUS : RadioWorker::REQUEST_ACTIVATE));
+                request.deviceID = FIRST_DEVICE_ID + (random >> 12) % options.inverters;
+                request.value = (random >> 16) % 101;
+                request.tag = submitted;
+                if (channel.submit(request))
+                {
+                    open[submitted++] = true;
+                }
+            }
+
+            RadioWorker::WorkerResult result;
+            while (channel.poll(result))
+            {
+                const uint32_t tag = result.request.tag;
+                const bool matches = tag < options.requests && open[tag]
+                    && (!result.success || result.request.type != RadioWorker::REQUEST_STATUS
+                        || (result.status.valid && result.status.deviceID == result.request.deviceID));
+                if (!matches)
+                {
+                    ++report.errors;
+                    fprintf(stderr, "consumer %u: unexpected result for tag %u\n", index, tag);
+                }
+                else
+                {
+                    open[tag] = false;
+                }
+                result.success ? ++report.succeeded : ++report.failed;
+                ++completed;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void usage(const char* name)
+    {
+        printf("Usage: %s [options]\n"
+               "  --inverters N     number of simulated inverters (default 8)\n"
+               "  --consumers N     number of consumer threads, 1-%zu (default 3)\n"
+               "  --requests N      requests per consumer (default 500)\n"
+               "  --in-flight K     outstanding requests of the async client (default 2)\n"
+               "  --loss P          request/reply loss probability 0-1 (default 0.02)\n"
+               "  --seed N          random seed (default 1)\n",
+            name, RadioWorker::MAX_CHANNELS);
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--inverters")
+        {
+            options.inverters = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--consumers")
+        {
+            options.consumers = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--requests")
+        {
+            options.requests = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--in-flight")
+        {
+            options.maxInFlight = strtoul(value, nullptr, 0);
+        }
+        else if (arg == "--loss")
+        {
+            options.loss = strtof(value, nullptr);
+        }
+        else if (arg == "--seed")
+        {
+            options.seed = strtoul(value, nullptr, 0);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!options.inverters || !options.consumers || options.consumers > RadioWorker::MAX_CHANNELS)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    host::reset();
+    sim::SimulatedLC12S radio(PROG_PIN, options.seed);
+    sim::LinkProfile link;
+    link.lossRate = options.loss;
+    radio.setLinkProfile(link);
+    for (uint32_t i = 0; i < options.inverters; ++i)
+    {
+        radio.addInverter(FIRST_DEVICE_ID + i);
+    }
+
+    BasicAsyncNETSGPClient<64> client(radio, PROG_PIN, 1);
+    client.setMaxInFlight(options.maxInFlight);
+    RadioWorker worker(client);
+    std::vector<RadioWorker::Channel> channels(options.consumers);
+    for (RadioWorker::Channel& channel : channels)
+    {
+        worker.attach(channel);
+    }
+
+    // The radio thread is the only one touching the client and the simulated module
+    std::atomic<bool> stop {false};
+    std::thread radioThread(
+        [&]()
+        {
+            while (!stop.load())
+            {
+                worker.step();
+                host::advanceMicros(200);
+            }
+        });
+
+    std::vector<ConsumerReport> reports(options.consumers);
+    std::vector<std::thread> consumers;
+    for (uint32_t i = 0; i < options.consumers; ++i)
+    {
+        consumers.emplace_back(consume, std::ref(channels[i]), std::cref(options), i, std::ref(reports[i]));
+    }
+    for (std::thread& consumer : consumers)
+    {
+        consumer.join();
+    }
+    stop = true;
+    radioThread.join();
+
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < options.consumers; ++i)
+    {
+        printf("consumer %u: succeeded %u  failed %u  errors %u\n", i, reports[i].succeeded, reports[i].failed,
+            reports[i].errors);
+        errors += reports[i].errors;
+    }
+    printf("simulated %.1f s  link requests %u  replies %u  lost %u\n", host::nowMicros() / 1e6,
+        radio.statistics().requests, radio.statistics().replies, radio.statistics().lost);
+    return errors ? 1 : 0;
+}
@@ -1,55 +1,1010 @@
 #include "AsyncNETSGPClient.h"
 
+#include <math.h>
+
 #include <Arduino.h>
 
-AsyncNETSGPClient::AsyncNETSGPClient(Stream& stream, const uint8_t progPin, const uint8_t interval)
-    : NETSGPClient(stream, progPin), mIntervalMS(1000 * interval), mDeviceIte(mDevices.begin())
+AsyncNETSGPClientBase::AsyncNETSGPClientBase(Stream& stream, const uint8_t progPin, const uint8_t interval,
+    DeviceRecord* storage, const size_t capacity)
+    : NETSGPClient(stream, progPin), mIntervalMS(1000 * interval), mLastSweepMS(millis() - mIntervalMS),
+      mDevices(storage, capacity)
 { }
 
-void AsyncNETSGPClient::update()
+bool AsyncNETSGPClientBase::setPowerGradeAsync(const uint32_t deviceID, const PowerGrade pg, CommandCallback callback,
+    const Priority priority, const uint32_t deadlineMS)
 {
-    const uint32_t currentMillis = millis();
+    return queueCommand(deviceID, Command::POWER_GRADE, pg, callback, priority, deadlineMS);
+}
+
+bool AsyncNETSGPClientBase::activateAsync(const uint32_t deviceID, const bool activate, CommandCallback callback,
+    const Priority priority, const uint32_t deadlineMS)
+{
+    return queueCommand(deviceID, Command::CONTROL, activate ? Control::ACTIVATE : Control::DEACTIVATE, callback,
+        priority, deadlineMS);
+}
+
+bool AsyncNETSGPClientBase::rebootAsync(
+    const uint32_t deviceID, CommandCallback callback, const Priority priority, const uint32_t deadlineMS)
+{
+    return queueCommand(deviceID, Command::CONTROL, Control::REBOOT, callback, priority, deadlineMS);
+}
+
+size_t AsyncNETSGPClientBase::queuedCommands() const
+{
+    size_t count = 0;
+    for (const Request& request : mQueue)
+    {
+        count += request.used;
+    }
+    return count;
+}
+
+size_t AsyncNETSGPClientBase::fillBatch(BatchEntry* entries, const size_t capacity, const uint8_t value) const
+{
+    size_t count = 0;
+    for (const DeviceRecord& record : mDevices)
+    {
+        if (count >= capacity)
+        {
+            break;
+        }
+        entries[count] = {};
+        entries[count].deviceID = record.deviceID;
+        entries[count].value = value;
+        ++count;
+    }
+    return count;
+}
+
+bool AsyncNETSGPClientBase::startPowerGradeBatch(
+    BatchEntry* entries, const size_t count, BatchCallback callback, const uint8_t maxAttempts)
+{
+    return startBatch(entries, count, Command::POWER_GRADE, callback, maxAttempts);
+}
+
+bool AsyncNETSGPClientBase::startActivateBatch(BatchEntry* entries, const size_t count, const bool activate,
+    BatchCallback callback, const uint8_t maxAttempts)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        entries[i].value = activate ? Control::ACTIVATE : Control::DEACTIVATE;
+    }
+    return startBatch(entries, count, Command::CONTROL, callback, maxAttempts);
+}
+
+void AsyncNETSGPClientBase::cancelBatch()
+{
+    // Replies to sent entries are still awaited, but must neither touch the caller owned entries nor be retried
+    for (InFlight& slot : mInFlight)
+    {
+        if (slot.request.batchEntry)
+        {
+            slot.request.batchEntry = nullptr;
+            slot.request.cancelled = true;
+        }
+    }
+    mBatch = nullptr;
+    mBatchCount = 0;
+    mBatchRemaining = 0;
+}
+
+bool AsyncNETSGPClientBase::addStatusListener(NETSGP::StatusListener& listener)
+{
+    NETSGP::StatusListener** freeSlot = nullptr;
+    for (NETSGP::StatusListener*& slot : mListeners)
+    {
+        if (slot == &listener)
+        {
+            return true;
+        }
+        if (!slot && !freeSlot)
+        {
+            freeSlot = &slot;
+        }
+    }
+    if (!freeSlot)
+    {
+        return false;
+    }
+    *freeSlot = &listener;
+    return true;
+}
+
+void AsyncNETSGPClientBase::removeStatusListener(NETSGP::StatusListener& listener)
+{
+    for (NETSGP::StatusListener*& slot : mListeners)
+    {
+        if (slot == &listener)
+        {
+            slot = nullptr;
+        }
+    }
+}
+
+void AsyncNETSGPClientBase::setChangeFilter(const ChangeFilter& filter)
+{
+    // Convert once, so comparing statuses does not need floating point math
+    mVoltageDeadband = static_cast<uint16_t>(filter.voltage * 100.0f + 0.5f);
+    mCurrentDeadband = static_cast<uint16_t>(filter.current * 100.0f + 0.5f);
+    mPowerDeadband = static_cast<uint32_t>(filter.power * 10000.0f + 0.5f);
+    mTotalDeadband = filter.totalGeneratedPower;
+    mTemperatureDeadband = filter.temperature;
+    mMaxSilenceMS = filter.maxSilenceMS;
+    mFilterEnabled = true;
+}
+
+bool AsyncNETSGPClientBase::getLastStatus(const uint32_t deviceID, InverterStatus& status) const
+{
+    NETSGP::CompactStatus compact;
+    if (!getLastStatus(deviceID, compact))
+    {
+        return false;
+    }
+    status = toInverterStatus(compact);
+    return true;
+}
+
+bool AsyncNETSGPClientBase::getLastStatus(const uint32_t deviceID, NETSGP::CompactStatus& status) const
+{
+    const DeviceRecord* record = mDevices.find(deviceID);
+    if (!record || !record->replies)
+    {
+        return false;
+    }
+    status = record->status;
+    return true;
+}
+
+bool AsyncNETSGPClientBase::getInverterInfo(const uint32_t deviceID, InverterInfo& info) const
+{
+    const DeviceRecord* record = mDevices.find(deviceID);
+    if (!record)
+    {
+        return false;
+    }
+    if (record->replies)
+    {
+        info.status = toInverterStatus(record->status);
+    }
+    else
+    {
+        info.status = {};
+        info.status.deviceID = deviceID;
+        info.status.valid = false;
+    }
+    info.ageMS = millis() - record->statusMS;
+    info.replies = record->replies;
+    info.timeouts = record->timeouts;
+    info.rttMS = record->rttMS;
+    info.latencyMS = record->latencyMS;
+    info.dirty = record->dirty;
+    info.health = healthOf(*record);
+    info.failures = record->failures;
+    return true;
+}
+
+size_t AsyncNETSGPClientBase::offlineCount() const
+{
+    size_t count = 0;
+    for (const DeviceRecord& record : mDevices)
+    {
+        count += healthOf(record) == HEALTH_OFFLINE;
+    }
+    return count;
+}
+
+bool AsyncNETSGPClientBase::sendProbe(const uint32_t deviceID, const uint16_t timeoutMS)
+{
+    if (mConfigState != CONFIG_IDLE || isInFlight(deviceID))
+    {
+        return false;
+    }
+    uint8_t inFlight = 0;
+    InFlight* freeSlot = nullptr;
+    for (InFlight& slot : mInFlight)
+    {
+        inFlight += slot.request.used;
+        if (!slot.request.used && !freeSlot)
+        {
+            freeSlot = &slot;
+        }
+    }
+    if (inFlight >= mMaxInFlight || !freeSlot)
+    {
+        return false;
+    }
+    freeSlot->request = {};
+    freeSlot->request.deviceID = deviceID;
+    freeSlot->request.command = Command::STATUS;
+    freeSlot->request.used = true;
+    freeSlot->request.probe = true;
+    freeSlot->sentMS = millis();
+    freeSlot->timeoutMS = timeoutMS;
+    sendCommand(deviceID, Command::STATUS);
+    return true;
+}
+
+void AsyncNETSGPClientBase::clearDirty(const uint32_t deviceID)
+{
+    DeviceRecord* record = mDevices.find(deviceID);
+    if (record)
+    {
+        record->dirty = false;
+    }
+}
+
+void AsyncNETSGPClientBase::setMaxInFlight(const uint8_t maxInFlight)
+{
+    mMaxInFlight = maxInFlight < 1 ? 1 : (maxInFlight > MAX_IN_FLIGHT ? MAX_IN_FLIGHT : maxInFlight);
+}
+
+bool AsyncNETSGPClientBase::applyRFModuleSettingsAsync(const LC12S::Settings& settings, ConfigCallback callback)
+{
+    if (mConfigState != CONFIG_IDLE)
+    {
+        return false;
+    }
+    mConfigTarget = settings;
+    mConfigTarget.valid = true;
+    if (mModuleSettings == mConfigTarget)
+    {
+        if (callback)
+        {
+            callback(true, mModuleSettings);
+        }
+        return true;
+    }
+    mConfigCallback = callback;
+    mConfigState = CONFIG_DRAINING;
+    return true;
+}
 
-    // Send comands at mIntervalMS
-    if (currentMillis - mLastUpdateMS >= mIntervalMS && !mCanSend)
+size_t AsyncNETSGPClientBase::update(const uint8_t maxFrames, const uint32_t maxMicros)
+{
+    if (mConfigState >= CONFIG_ENTERING)
     {
-        mCanSend = true;
+        // The RF module talks configuration frames now, these must not reach the frame parser
+        updateConfig(millis());
+        return mStream.available();
     }
 
-    if (mCanSend && currentMillis - mLastSendMS >= 1010)
+    const uint32_t startMicros = micros();
+
+    // Check for answers first, so the next request can go out right away
+    uint8_t frames = 0;
+    while (readReply())
     {
-        if (mDeviceIte != mDevices.end())
+        ++frames;
+        if (NETSGP::Codec::CommandFrame::Command::read(&mBuffer[0]) == Command::STATUS)
         {
-            mLastSendMS = currentMillis;
-            mLastUpdateMS = currentMillis;
-            sendCommand(*mDeviceIte, Command::STATUS);
-            DEBUGF("Sent STATUS request to %#08x\n", *mDeviceIte);
-            mCanSend = false;
-            ++mDeviceIte;
+            handleStatusReply();
         }
         else
         {
-            mCanSend = false; // make sure we only poll every mIntervalMS
-            mDeviceIte = mDevices.begin();
+            handleCommandReply();
+        }
+
+        if ((maxFrames && frames >= maxFrames) || (maxMicros && micros() - startMicros >= maxMicros))
+        {
+            break;
+        }
+    }
+
+    const uint32_t currentMillis = millis();
+    uint8_t inFlight = 0;
+    for (InFlight& slot : mInFlight)
+    {
+        if (slot.request.used && currentMillis - slot.sentMS >= slot.timeoutMS)
+        {
+            DEBUGF("Request %#02x to %#08x timed out after %ums\n", slot.request.command, slot.request.deviceID,
+                slot.timeoutMS);
+            slot.request.used = false;
+            if (slot.request.probe)
+            {
+                // Most probes go to identifiers without an inverter, their silence says nothing about the link
+                continue;
+            }
+            ++mStatistics.timeouts;
+            DeviceRecord* record = mDevices.find(slot.request.deviceID);
+            if (record)
+            {
+                ++record->timeouts;
+                if (slot.request.command == Command::STATUS && record->failures < 0xFF)
+                {
+                    ++record->failures;
+                    record->failedMS = currentMillis;
+                }
+            }
+            if (slot.request.command != Command::STATUS)
+            {
+                completeCommand(slot.request, COMMAND_TIMEOUT);
+            }
+        }
+        inFlight += slot.request.used;
+    }
+
+    if (mConfigState == CONFIG_DRAINING)
+    {
+        if (inFlight == 0)
+        {
+            updateConfig(currentMillis);
+        }
+        return mStream.available();
+    }
+
+    for (InFlight& slot : mInFlight)
+    {
+        if (inFlight >= mMaxInFlight)
+        {
+            break;
+        }
+        if (!slot.request.used)
+        {
+            if (!sendNextCommand(currentMillis, slot) && !sendNextBatchEntry(currentMillis, slot)
+                && !sendNextStatusRequest(currentMillis, slot))
+            {
+                break;
+            }
+            ++inFlight;
+        }
+    }
+
+    return mStream.available();
+}
+
+uint32_t AsyncNETSGPClientBase::nextActionMS() const
+{
+    const uint32_t currentMillis = millis();
+    uint32_t next = NO_ACTION;
+    const auto until = [&next, currentMillis](const uint32_t startMS, const uint32_t periodMS)
+    {
+        const uint32_t elapsed = currentMillis - startMS;
+        const uint32_t remaining = elapsed < periodMS ? periodMS - elapsed : 0;
+        next = remaining < next ? remaining : next;
+    };
+
+    switch (mConfigState)
+    {
+    case CONFIG_ENTERING:
+        until(mConfigMS, PROGRAMMING_DELAY_MS);
+        return next;
+    case CONFIG_READING:
+    case CONFIG_WRITING:
+        until(mConfigMS, CONFIG_TIMEOUT_MS);
+        return next;
+    default:
+        break;
+    }
+
+    uint8_t inFlight = 0;
+    for (const InFlight& slot : mInFlight)
+    {
+        if (slot.request.used)
+        {
+            until(slot.sentMS, slot.timeoutMS);
+            ++inFlight;
+        }
+    }
+    if (mConfigState == CONFIG_DRAINING)
+    {
+        return inFlight ? next : 0;
+    }
+    if (inFlight >= mMaxInFlight)
+    {
+        return next;
+    }
+
+    for (const Request& request : mQueue)
+    {
+        if (request.used && !isInFlight(request.deviceID))
+        {
+            const int32_t waitMS = static_cast<int32_t>(request.retryMS - currentMillis);
+            if (waitMS <= 0)
+            {
+                return 0;
+            }
+            until(currentMillis, waitMS);
+        }
+    }
+    if (mBatch)
+    {
+        for (size_t i = 0; i < mBatchCount; ++i)
+        {
+            const BatchEntry& entry = mBatch[i];
+            if (!entry.done && !isInFlight(entry.deviceID))
+            {
+                const int32_t waitMS = static_cast<int32_t>(entry.retryMS - currentMillis);
+                until(currentMillis, waitMS > 0 ? waitMS : 0);
+            }
+        }
+    }
+    if (mSweeping)
+    {
+        const DeviceRecord* record = mDevices.lowerBound(mNextDeviceID);
+        if (!record || !isInFlight(record->deviceID))
+        {
+            return 0;
+        }
+    }
+    else if (!mDevices.empty())
+    {
+        until(mLastSweepMS, mIntervalMS);
+    }
+    return next;
+}
+
+bool AsyncNETSGPClientBase::queueCommand(const uint32_t deviceID, const Command command, const uint8_t value,
+    CommandCallback callback, const Priority priority, const uint32_t deadlineMS)
+{
+    for (Request& request : mQueue)
+    {
+        if (!request.used)
+        {
+            const uint32_t currentMillis = millis();
+            request = {};
+            request.deviceID = deviceID;
+            request.command = command;
+            request.value = value;
+            request.priority = priority;
+            request.used = true;
+            request.hasDeadline = deadlineMS != 0;
+            request.deadlineMS = currentMillis + deadlineMS;
+            request.queuedMS = currentMillis;
+            request.sequence = mSequence++;
+            request.attempts = 0;
+            request.outcome = COMMAND_EXPIRED;
+            request.retryMS = currentMillis;
+            request.callback = callback;
+            return true;
+        }
+    }
+    DEBUGLN("[queueCommand] Queue is full");
+    return false;
+}
+
+AsyncNETSGPClientBase::InFlight* AsyncNETSGPClientBase::findInFlight()
+{
+    const uint32_t deviceID = deviceIDFromBuffer(&mBuffer[0]);
+    const uint8_t command = NETSGP::Codec::CommandFrame::Command::read(&mBuffer[0]);
+    for (InFlight& slot : mInFlight)
+    {
+        if (slot.request.used && slot.request.deviceID == deviceID && slot.request.command == command)
+        {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+bool AsyncNETSGPClientBase::isInFlight(const uint32_t deviceID) const
+{
+    for (const InFlight& slot : mInFlight)
+    {
+        if (slot.request.used && slot.request.deviceID == deviceID)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AsyncNETSGPClientBase::handleStatusReply()
+{
+    const NETSGP::StatusFrame frame(&mBuffer[0]);
+    if (!frame.valid())
+    {
+        return;
+    }
+    const NETSGP::CompactStatus status = frame.compact();
+
+    const uint32_t currentMillis = millis();
+    DeviceRecord* record = mDevices.find(status.deviceID);
+    InFlight* slot = findInFlight();
+    if (slot)
+    {
+        slot->request.used = false;
+        countReply(currentMillis - slot->sentMS);
+        if (record)
+        {
+            record->addSample(currentMillis - slot->sentMS);
         }
     }
 
-    // Check for answers
-    while (mStream.available() >= 27)
+    bool announce = true;
+    if (record)
     {
-        // Search for status message
-        if (findAndReadReply(Command::STATUS))
+        ++record->replies;
+        record->failures = 0;
+        record->status = status;
+        record->statusMS = currentMillis;
+
+        announce = !mFilterEnabled || !record->hasAnnounced || exceedsChangeFilter(status, record->announced)
+            || (mMaxSilenceMS && currentMillis - record->announcedMS >= mMaxSilenceMS);
+        if (announce)
         {
-            dumpBuffer();
-            InverterStatus status;
-            if (fillInverterStatusFromBuffer(&mBuffer[0], status))
+            record->announced = status;
+            record->announcedMS = currentMillis;
+            record->hasAnnounced = true;
+            // Without a callback the change stays pending for consumers polling getInverterInfo()
+            record->dirty = mCallback == nullptr && mCompactCallback == nullptr;
+        }
+    }
+
+    // The record must not be used below, listeners and callbacks may deregister the inverter
+    for (NETSGP::StatusListener* listener : mListeners)
+    {
+        if (listener)
+        {
+            const uint32_t startMicros = micros();
+            listener->onStatus(status, currentMillis);
+            countCallback(startMicros);
+        }
+    }
+
+    if (!announce)
+    {
+        return;
+    }
+    if (mCompactCallback)
+    {
+        const uint32_t startMicros = micros();
+        mCompactCallback(status);
+        countCallback(startMicros);
+    }
+    if (mCallback)
+    {
+        const uint32_t startMicros = micros();
+        mCallback(toInverterStatus(status));
+        countCallback(startMicros);
+    }
+}
+
+bool AsyncNETSGPClientBase::exceedsChangeFilter(
+    const NETSGP::CompactStatus& status, const NETSGP::CompactStatus& reference) const
+{
+    const auto exceeds = [](const uint32_t a, const uint32_t b, const uint32_t deadband)
+    { return (a > b ? a - b : b - a) >= deadband; };
+
+    return status.state != reference.state
+        || exceeds(status.temperature, reference.temperature, mTemperatureDeadband)
+        || exceeds(status.dcVoltage, reference.dcVoltage, mVoltageDeadband)
+        || exceeds(status.acVoltage, reference.acVoltage, mVoltageDeadband)
+        || exceeds(status.dcCurrent, reference.dcCurrent, mCurrentDeadband)
+        || exceeds(status.acCurrent, reference.acCurrent, mCurrentDeadband)
+        || exceeds(status.dcPowerRaw(), reference.dcPowerRaw(), mPowerDeadband)
+        || exceeds(status.acPowerRaw(), reference.acPowerRaw(), mPowerDeadband)
+        || (status.totalGeneratedPowerBits != reference.totalGeneratedPowerBits
+            && fabsf(status.totalGeneratedPower() - reference.totalGeneratedPower()) >= mTotalDeadband);
+}
+
+void AsyncNETSGPClientBase::handleCommandReply()
+{
+    InFlight* slot = findInFlight();
+    if (!slot)
+    {
+        DEBUGF("Dropping unexpected reply %#02x from %#08x\n", NETSGP::Codec::CommandFrame::Command::read(&mBuffer[0]),
+            deviceIDFromBuffer(&mBuffer[0]));
+        return;
+    }
+
+    slot->request.used = false;
+    const uint32_t latencyMS = millis() - slot->sentMS;
+    countReply(latencyMS);
+    DeviceRecord* record = mDevices.find(slot->request.deviceID);
+    if (record)
+    {
+        record->addSample(latencyMS);
+        record->failures = 0;
+    }
+
+    const bool crc = NETSGP::Codec::CommandFrame::valid(&mBuffer[0]);
+    const bool valid = NETSGP::Codec::CommandFrame::Value::read(&mBuffer[0]) == slot->request.value;
+    completeCommand(slot->request, crc && valid ? COMMAND_SUCCESS : COMMAND_FAILED);
+}
+
+void AsyncNETSGPClientBase::completeCommand(const Request& request, const CommandOutcome outcome, const bool mayRetry)
+{
+    if (request.cancelled)
+    {
+        return;
+    }
+    if (request.batchEntry)
+    {
+        completeBatchEntry(*request.batchEntry, outcome);
+        return;
+    }
+    if (mayRetry && (outcome == COMMAND_TIMEOUT || outcome == COMMAND_FAILED) && request.attempts
+        && request.attempts <= mHealth.commandRetries)
+    {
+        // Queue it again keeping its sequence, a full queue ends the retries
+        for (Request& retry : mQueue)
+        {
+            if (!retry.used)
             {
-                if (mCallback)
+                retry = request;
+                retry.used = true;
+                retry.outcome = outcome;
+                retry.retryMS = millis() + retryBackoffMS(request.attempts);
+                return;
+            }
+        }
+    }
+    if (!request.callback && !mCommandListener)
+    {
+        return;
+    }
+    const CommandResult result = {request.deviceID, static_cast<uint8_t>(request.command), request.value, outcome,
+        static_cast<uint32_t>(millis() - request.queuedMS), request.attempts};
+    if (request.callback)
+    {
+        const uint32_t startMicros = micros();
+        request.callback(result);
+        countCallback(startMicros);
+    }
+    if (mCommandListener)
+    {
+        const uint32_t startMicros = micros();
+        mCommandListener->onCommand(result);
+        countCallback(startMicros);
+    }
+}
+
+bool AsyncNETSGPClientBase::sendNextCommand(const uint32_t currentMillis, InFlight& slot)
+{
+    Request* next = nullptr;
+    for (Request& request : mQueue)
+    {
+        if (!request.used)
+        {
+            continue;
+        }
+
+        if (request.hasDeadline && static_cast<int32_t>(currentMillis - request.deadlineMS) > 0)
+        {
+            DEBUGF("Command %#02x to %#08x expired\n", request.command, request.deviceID);
+            request.used = false;
+            // A retry that ran out of time reports why it was retried and is never retried again
+            completeCommand(request, request.attempts ? request.outcome : COMMAND_EXPIRED, false);
+            continue;
+        }
+
+        if (isInFlight(request.deviceID) || static_cast<int32_t>(currentMillis - request.retryMS) < 0)
+        {
+            continue;
+        }
+
+        if (!next || request.priority > next->priority)
+        {
+            next = &request;
+        }
+        else if (request.priority == next->priority)
+        {
+            // Earliest deadline first, commands without deadline after those with one, then queueing order
+            if (request.hasDeadline != next->hasDeadline)
+            {
+                if (request.hasDeadline)
+                {
+                    next = &request;
+                }
+            }
+            else if (request.hasDeadline && request.deadlineMS != next->deadlineMS)
+            {
+                if (static_cast<int32_t>(request.deadlineMS - next->deadlineMS) < 0)
                 {
-                    mCallback(status);
+                    next = &request;
                 }
-                mCanSend = true;
+            }
+            else if (static_cast<int32_t>(request.sequence - next->sequence) < 0)
+            {
+                next = &request;
+            }
+        }
+    }
+
+    if (!next)
+    {
+        return false;
+    }
+
+    slot.request = *next;
+    ++slot.request.attempts;
+    next->used = false;
+    sendRequest(currentMillis, slot);
+    return true;
+}
+
+bool AsyncNETSGPClientBase::startBatch(BatchEntry* entries, const size_t count, const Command command,
+    BatchCallback callback, const uint8_t maxAttempts)
+{
+    if (mBatch || !entries || !count)
+    {
+        return false;
+    }
+
+    const uint32_t currentMillis = millis();
+    for (size_t i = 0; i < count; ++i)
+    {
+        entries[i].attempts = 0;
+        entries[i].done = false;
+        entries[i].outcome = COMMAND_TIMEOUT;
+        entries[i].latencyMS = 0;
+        entries[i].retryMS = currentMillis;
+    }
+    mBatch = entries;
+    mBatchCount = count;
+    mBatchRemaining = count;
+    mBatchCommand = command;
+    mBatchMaxAttempts = maxAttempts ? maxAttempts : 1;
+    mBatchStartMS = currentMillis;
+    mBatchCallback = callback;
+    return true;
+}
+
+void AsyncNETSGPClientBase::completeBatchEntry(BatchEntry& entry, const CommandOutcome outcome)
+{
+    const uint32_t currentMillis = millis();
+    entry.outcome = outcome;
+    if (outcome != COMMAND_SUCCESS && entry.attempts < mBatchMaxAttempts)
+    {
+        entry.retryMS = currentMillis + retryBackoffMS(entry.attempts);
+        return;
+    }
+
+    entry.done = true;
+    entry.latencyMS = currentMillis - mBatchStartMS;
+    if (--mBatchRemaining)
+    {
+        return;
+    }
+
+    BatchResult result = {mBatch, mBatchCount, 0, currentMillis - mBatchStartMS};
+    for (size_t i = 0; i < mBatchCount; ++i)
+    {
+        result.succeeded += mBatch[i].outcome == COMMAND_SUCCESS;
+    }
+    // Finish before notifying, so the callback can start the next batch
+    const BatchCallback callback = mBatchCallback;
+    mBatch = nullptr;
+    mBatchCount = 0;
+    if (callback)
+    {
+        const uint32_t startMicros = micros();
+        callback(result);
+        countCallback(startMicros);
+    }
+}
+
+uint32_t AsyncNETSGPClientBase::retryBackoffMS(const uint8_t attempts)
+{
+    // Larger shifts would overflow, the maxAttempts of a batch is up to the caller
+    const uint8_t doublings = attempts < 2 ? 0 : (attempts - 1 < 16 ? attempts - 1 : 16);
+    return static_cast<uint32_t>(BATCH_BACKOFF_MS) << doublings;
+}
+
+bool AsyncNETSGPClientBase::sendNextBatchEntry(const uint32_t currentMillis, InFlight& slot)
+{
+    if (!mBatch)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < mBatchCount; ++i)
+    {
+        BatchEntry& entry = mBatch[i];
+        if (entry.done || static_cast<int32_t>(currentMillis - entry.retryMS) < 0 || isInFlight(entry.deviceID))
+        {
+            continue;
+        }
+
+        slot.request = {};
+        slot.request.deviceID = entry.deviceID;
+        slot.request.command = mBatchCommand;
+        slot.request.value = entry.value;
+        slot.request.used = true;
+        slot.request.queuedMS = mBatchStartMS;
+        slot.request.batchEntry = &entry;
+        ++entry.attempts;
+        sendRequest(currentMillis, slot);
+        return true;
+    }
+    return false;
+}
+
+bool AsyncNETSGPClientBase::sendNextStatusRequest(const uint32_t currentMillis, InFlight& slot)
+{
+    if (!mSweeping)
+    {
+        // Make sure we only start a sweep every mIntervalMS
+        if (currentMillis - mLastSweepMS < mIntervalMS || mDevices.empty())
+        {
+            return false;
+        }
+        mLastSweepMS = currentMillis;
+        mSweeping = true;
+        mNextDeviceID = 0;
+    }
+
+    // Searching by identifier instead of keeping a position keeps the sweep valid while devices come and go
+    const DeviceRecord* record = mDevices.lowerBound(mNextDeviceID);
+    while (record && !pollDue(*record, currentMillis))
+    {
+        mNextDeviceID = record->deviceID + 1;
+        record = mNextDeviceID ? mDevices.lowerBound(mNextDeviceID) : nullptr;
+    }
+    if (!record)
+    {
+        mSweeping = false;
+        return false;
+    }
+
+    if (isInFlight(record->deviceID))
+    {
+        // Wait for the outstanding request to this device
+        return false;
+    }
+
+    slot.request = {};
+    slot.request.deviceID = record->deviceID;
+    slot.request.command = Command::STATUS;
+    slot.request.used = true;
+    mNextDeviceID = record->deviceID + 1;
+    mSweeping = mNextDeviceID != 0; // Identifier overflow means all devices were polled
+    sendRequest(currentMillis, slot);
+    if (healthOf(*record) == HEALTH_OFFLINE)
+    {
+        mLastProbeMS = currentMillis;
+        const uint8_t share = mHealth.probeSharePercent ? mHealth.probeSharePercent : 1;
+        mProbeGapMS = static_cast<uint32_t>(slot.timeoutMS) * 100 / share;
+    }
+    return true;
+}
+
+bool AsyncNETSGPClientBase::pollDue(const DeviceRecord& record, const uint32_t currentMillis) const
+{
+    // A single lost frame must not cost a sweep
+    if (!mHealth.offlineAfter || record.failures < 2)
+    {
+        return true;
+    }
+    const uint32_t elapsed = currentMillis - record.failedMS;
+    if (record.failures < mHealth.offlineAfter)
+    {
+        const uint8_t doublings = record.failures - 2 < 16 ? record.failures - 2 : 16;
+        const uint32_t backoff = static_cast<uint32_t>(mHealth.backoffMS) << doublings;
+        return elapsed >= (backoff < mHealth.probeIntervalMS ? backoff : mHealth.probeIntervalMS);
+    }
+    return elapsed >= mHealth.probeIntervalMS && currentMillis - mLastProbeMS >= mProbeGapMS;
+}
+
+AsyncNETSGPClientBase::Health AsyncNETSGPClientBase::healthOf(const DeviceRecord& record) const
+{
+    if (!record.failures)
+    {
+        return HEALTH_ONLINE;
+    }
+    return mHealth.offlineAfter && record.failures >= mHealth.offlineAfter ? HEALTH_OFFLINE : HEALTH_BACKOFF;
+}
+
+void AsyncNETSGPClientBase::sendRequest(const uint32_t currentMillis, InFlight& slot)
+{
+    const DeviceRecord* record = mDevices.find(slot.request.deviceID);
+    slot.timeoutMS = record ? record->timeoutMS() : MAX_TIMEOUT_MS;
+    slot.sentMS = currentMillis;
+    sendCommand(slot.request.deviceID, slot.request.command, slot.request.value);
+    DEBUGF("Sent request %#02x to %#08x\n", slot.request.command, slot.request.deviceID);
+}
+
+void AsyncNETSGPClientBase::DeviceRecord::addSample(const uint16_t sampleMS)
+{
+    latencyMS.add(sampleMS);
+    if (!rttMS)
+    {
+        rttMS = sampleMS ? sampleMS : 1;
+        rttVarMS = sampleMS / 2;
+        return;
+    }
+
+    // Same smoothing as TCP (RFC 6298) with alpha = 1/8 and beta = 1/4
+    const int32_t error = static_cast<int32_t>(sampleMS) - rttMS;
+    rttVarMS += ((error < 0 ? -error : error) - static_cast<int32_t>(rttVarMS)) / 4;
+    rttMS += error / 8;
+    if (!rttMS)
+    {
+        rttMS = 1;
+    }
+}
+
+uint16_t AsyncNETSGPClientBase::DeviceRecord::timeoutMS() const
+{
+    if (!rttMS)
+    {
+        return MAX_TIMEOUT_MS;
+    }
+    const uint32_t margin = 4 * rttVarMS > MIN_TIMEOUT_MARGIN_MS ? 4 * rttVarMS : MIN_TIMEOUT_MARGIN_MS;
+    const uint32_t timeout = rttMS + margin;
+    return timeout < MAX_TIMEOUT_MS ? timeout : MAX_TIMEOUT_MS;
+}
+
+void AsyncNETSGPClientBase::updateConfig(const uint32_t currentMillis)
+{
+    switch (mConfigState)
+    {
+    case CONFIG_DRAINING:
+        digitalWrite(mProgPin, LOW);
+        mConfigMS = currentMillis;
+        mConfigState = CONFIG_ENTERING;
+        break;
+    case CONFIG_ENTERING:
+        if (currentMillis - mConfigMS >= PROGRAMMING_DELAY_MS)
+        {
+            // Late replies to earlier requests would corrupt the configuration reply
+            flushInput();
+            sendConfigFrame(currentMillis, CONFIG_READ, LC12S::Settings());
+            mConfigState = CONFIG_READING;
+        }
+        break;
+    case CONFIG_READING:
+    case CONFIG_WRITING:
+    {
+        int byte;
+        while (mConfigReceived < CONFIG_FRAME_SIZE && (byte = mStream.read()) >= 0)
+        {
+            mConfigBuffer[mConfigReceived++] = byte;
+            ++mStatistics.bytesIn;
+        }
+        if (mConfigReceived < CONFIG_FRAME_SIZE)
+        {
+            if (currentMillis - mConfigMS >= CONFIG_TIMEOUT_MS)
+            {
+                DEBUGLN("[updateConfig] Timeout");
+                finishConfig(false);
+            }
+            break;
+        }
+
+        LC12S::Settings settings;
+        const bool valid = parseConfigReply(mConfigState == CONFIG_READING ? CONFIG_READ : CONFIG_WRITE, settings);
+        if (valid && mConfigState == CONFIG_READING && settings != mConfigTarget)
+        {
+            // Keep the moduleID since that is unique for each module
+            mConfigTarget.moduleID = settings.moduleID;
+            sendConfigFrame(currentMillis, CONFIG_WRITE, mConfigTarget);
+            mConfigState = CONFIG_WRITING;
+            break;
+        }
+        if (valid && mConfigState == CONFIG_WRITING)
+        {
+            // Inverters lost on the old channel or network deserve a new chance on the new one
+            for (DeviceRecord& record : mDevices)
+            {
+                record.failures = 0;
             }
         }
+        finishConfig(valid);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void AsyncNETSGPClientBase::sendConfigFrame(
+    const uint32_t currentMillis, const uint8_t command, const LC12S::Settings& settings)
+{
+    buildConfigFrame(command, settings);
+    mStatistics.bytesOut += mStream.write(&mConfigBuffer[0], CONFIG_FRAME_SIZE);
+    mConfigReceived = 0;
+    mConfigMS = currentMillis;
+}
+
+void AsyncNETSGPClientBase::finishConfig(const bool success)
+{
+    disableProgramming();
+    mConfigState = CONFIG_IDLE;
+    if (mConfigCallback)
+    {
+        const uint32_t startMicros = micros();
+        mConfigCallback(success, mModuleSettings);
+        countCallback(startMicros);
     }
-}
\ No newline at end of file
+}
@@ -1,49 +1,612 @@
 #pragma once
 
-#include <set>
-
+#include "DeviceRegistry.h"
 #include "NETSGPClient.h"
+#include "StatusListener.h"
 
-/// @brief Async version of NETSGPClient
-class AsyncNETSGPClient : public NETSGPClient
+/// @brief Async version of NETSGPClient, see BasicAsyncNETSGPClient and AsyncNETSGPClient for instantiable variants
+///
+/// All requests, STATUS polling as well as queued control commands, share a single scheduler. By default it never has
+/// more than one request outstanding on the link, see setMaxInFlight() for pipelining.
+/// @note Do not use the blocking calls inherited from NETSGPClient while polling, use the queued variants instead
+class AsyncNETSGPClientBase : public NETSGPClient
 {
+public:
+    /// @brief Priority of queued commands, higher priorities are sent first. STATUS polling always comes last.
+    enum Priority
+    {
+        PRIORITY_LOW = 0, /// Low priority
+        PRIORITY_NORMAL = 1, /// Normal priority
+        PRIORITY_HIGH = 2, /// High priority, e.g. power grade changes for export limiting
+        PRIORITY_URGENT = 3, /// Urgent priority
+    };
+
+    /// @brief Outcome of a queued command
+    enum CommandOutcome
+    {
+        COMMAND_SUCCESS, /// Reply received and validated
+        COMMAND_FAILED, /// Reply received but did not validate
+        COMMAND_TIMEOUT, /// No reply received within timeout
+        COMMAND_EXPIRED, /// Deadline passed before the command could be sent
+    };
+
+    /// @brief Result of a queued command
+    struct CommandResult
+    {
+        uint32_t deviceID; /// Unique inverter identifier
+        uint8_t command; /// Command that was sent, CONTROL or POWER_GRADE
+        uint8_t value; /// Value that was sent (power grade or control value)
+        CommandOutcome outcome; /// Outcome of the command
+        uint32_t latencyMS; /// Time from queueing to completion in milliseconds
+        uint8_t attempts; /// Amount of times the command was sent, see HealthPolicy::commandRetries
+    };
+
+    /// @brief One command of a batch, the array of entries is owned by the caller
+    struct BatchEntry
+    {
+        uint32_t deviceID; /// Recipient inverter identifier
+        uint8_t value; /// Power grade or control value to send
+        uint8_t attempts; /// Amount of times the command was sent
+        bool done; /// Is the outcome final
+        CommandOutcome outcome; /// Outcome of the last attempt, final if done is true
+        uint32_t latencyMS; /// Time from starting the batch to completion of this entry in milliseconds
+        uint32_t retryMS; /// Earliest time of the next attempt
+    };
+
+    /// @brief Summary of a completed batch
+    struct BatchResult
+    {
+        const BatchEntry* entries; /// Entries of the batch with their outcomes
+        size_t count; /// Amount of entries
+        size_t succeeded; /// Amount of entries completed with COMMAND_SUCCESS
+        uint32_t durationMS; /// Time from starting the batch to completion of the last entry in milliseconds
+    };
+
+    /// @brief Health of a registered inverter, derived from consecutive STATUS timeouts
+    enum Health
+    {
+        HEALTH_ONLINE, /// Replied to its last request
+        HEALTH_BACKOFF, /// Missed its last requests, polled with growing pauses
+        HEALTH_OFFLINE, /// Missed HealthPolicy::offlineAfter requests in a row, only probed now and then
+    };
+
+    /// @brief Handling of unresponsive inverters and failed commands, see setHealthPolicy()
+    struct HealthPolicy
+    {
+        uint8_t offlineAfter = 4; /// Consecutive timeouts after which an inverter is offline, 0 to always poll all
+        uint16_t backoffMS = 5000; /// Pause after the second timeout in a row, doubles with each further timeout
+        uint32_t probeIntervalMS = 60000; /// Time between probes of an offline inverter, also the longest pause
+        uint8_t probeSharePercent = 5; /// Maximum share of the link time spent waiting on offline probes
+        uint8_t commandRetries = 0; /// Extra attempts of queued commands that timed out or failed
+    };
+
+    /// @brief Cached state of a registered inverter
+    struct InverterInfo
+    {
+        InverterStatus status; /// Last received status, status.valid is false if none was received yet
+        uint32_t ageMS; /// Time since status was received in milliseconds
+        uint32_t replies; /// Amount of valid replies received
+        uint32_t timeouts; /// Amount of requests that timed out
+        uint16_t rttMS; /// Smoothed reply latency in milliseconds, 0 if not measured yet
+        NETSGP::Histogram<uint16_t> latencyMS; /// Reply latency in milliseconds
+        bool dirty; /// Status changed beyond the deadbands without a callback to announce it, see clearDirty()
+        Health health; /// Health derived from consecutive timeouts
+        uint8_t failures; /// STATUS requests that timed out in a row
+    };
+
+    /// @brief Deadbands for change only status callbacks, see setChangeFilter()
+    struct ChangeFilter
+    {
+        float voltage = 0.5f; /// Minimum change of dcVoltage or acVoltage in Volts
+        float current = 0.05f; /// Minimum change of dcCurrent or acCurrent in Amperes
+        float power = 2.0f; /// Minimum change of dcPower or acPower in Watts
+        float totalGeneratedPower = 0.01f; /// Minimum change of totalGeneratedPower
+        uint8_t temperature = 1; /// Minimum change of temperature
+        uint32_t maxSilenceMS = 0; /// Announce at least this often even without change, 0 to never force
+    };
+
     /// @brief Callback function type definition for inverter status updates
     typedef void (*InverterStatusCallback)(const NETSGPClient::InverterStatus&);
 
-public:
-    /// @brief Construct a new AsyncNETSGPClient object.
+    /// @brief Callback function type definition for compact inverter status updates
+    typedef void (*CompactStatusCallback)(const NETSGP::CompactStatus&);
+
+    /// @brief Callback function type definition for completed commands
+    typedef void (*CommandCallback)(const CommandResult&);
+
+    /// @brief Interface for components consuming the results of all queued commands
+    class CommandListener
+    {
+    public:
+        virtual ~CommandListener() { }
+
+        /// @brief Called for every completed queued command after its callback, not for batch entries
+        ///
+        /// @param result Result of the command
+        virtual void onCommand(const CommandResult& result) = 0;
+    };
+
+    /// @brief Callback function type definition for completed batches
+    typedef void (*BatchCallback)(const BatchResult&);
+
+    /// @brief Callback function type definition for completed RF module configuration
+    typedef void (*ConfigCallback)(const bool success, const LC12S::Settings& settings);
+
+    constexpr static const uint8_t MAX_IN_FLIGHT = 4; /// Maximum amount of outstanding requests
+    constexpr static const uint8_t MAX_STATUS_LISTENERS = 4; /// Maximum amount of status listeners
+    constexpr static const uint32_t NO_ACTION = 0xFFFFFFFF; /// Returned by nextActionMS() if nothing is pending
+    constexpr static const uint16_t PROBE_TIMEOUT_MS = 150; /// Default time a probe holds its in flight slot
+
+protected:
+    /// @brief Per inverter record stored in the device registry
+    struct DeviceRecord
+    {
+        uint32_t deviceID; /// Unique inverter identifier
+        uint16_t rttMS = 0; /// Smoothed reply latency in milliseconds, 0 if not measured yet
+        uint16_t rttVarMS = 0; /// Smoothed reply latency deviation in milliseconds
+        NETSGP::Histogram<uint16_t> latencyMS = {}; /// Reply latency in milliseconds
+        uint32_t replies = 0; /// Amount of valid replies received
+        uint32_t timeouts = 0; /// Amount of requests that timed out
+        uint32_t statusMS = 0; /// Time the last status was received
+        uint32_t announcedMS = 0; /// Time the last status was announced
+        bool dirty = false; /// Did the status change beyond the deadbands without being announced
+        bool hasAnnounced = false; /// Is announced valid
+        uint8_t failures = 0; /// STATUS requests that timed out in a row
+        uint32_t failedMS = 0; /// Time of the last STATUS timeout
+        NETSGP::CompactStatus status = {}; /// Last received status, valid if replies is not 0
+        NETSGP::CompactStatus announced = {}; /// Last announced status, reference for the deadbands
+
+        /// @brief Add a measured reply latency to the moving averages and the histogram
+        ///
+        /// @param sampleMS Measured reply latency in milliseconds
+        void addSample(const uint16_t sampleMS);
+
+        /// @brief Get the reply timeout for the next request
+        uint16_t timeoutMS() const;
+    };
+
+    /// @brief Construct a new AsyncNETSGPClientBase object.
     ///
     /// @param stream Stream to communicate with the RF module
     /// @param progPin Programming enable pin of RF module (active low)
-    /// @param interval The update interval in seconds, default is 2 seconds
-    AsyncNETSGPClient(Stream& stream, const uint8_t progPin, const uint8_t interval = 2);
+    /// @param interval The update interval in seconds
+    /// @param storage Storage for the device registry, only its address is used during construction
+    /// @param capacity Maximum amount of inverters in storage
+    AsyncNETSGPClientBase(Stream& stream, const uint8_t progPin, const uint8_t interval, DeviceRecord* storage,
+        const size_t capacity);
+
+public:
+    AsyncNETSGPClientBase(const AsyncNETSGPClientBase&) = delete;
+    AsyncNETSGPClientBase& operator=(const AsyncNETSGPClientBase&) = delete;
 
     /// @brief Set the callback for inverter status updates
     ///
     /// @param callback Callback that gets called on updates, may be nullptr
     void setStatusCallback(InverterStatusCallback callback) { mCallback = callback; }
 
+    /// @brief Set the callback for compact inverter status updates
+    ///
+    /// Compact statuses are decoded without floating point math, prefer this if you do not need all values as float.
+    /// @param callback Callback that gets called on updates, may be nullptr
+    void setCompactStatusCallback(CompactStatusCallback callback) { mCompactCallback = callback; }
+
+    /// @brief Add a listener that receives every valid status, unaffected by the change filter
+    ///
+    /// @param listener Listener to add, must outlive this client or be removed before
+    /// @return true If the listener was added or already present
+    /// @return false If MAX_STATUS_LISTENERS are already present
+    bool addStatusListener(NETSGP::StatusListener& listener);
+
+    /// @brief Remove a previously added status listener
+    ///
+    /// @param listener Listener to remove
+    void removeStatusListener(NETSGP::StatusListener& listener);
+
+    /// @brief Set the listener for the results of all queued commands
+    ///
+    /// @param listener Listener that gets called on completion, may be nullptr
+    void setCommandListener(CommandListener* listener) { mCommandListener = listener; }
+
+    /// @brief Only announce status updates of registered inverters that changed beyond the given deadbands.
+    ///
+    /// A change of the state byte is always announced. Suppressed updates still refresh the cache, see
+    /// getLastStatus(). Without a status callback changes beyond the deadbands mark the inverter as dirty instead,
+    /// see getInverterInfo() and clearDirty().
+    /// @param filter Deadbands to use
+    void setChangeFilter(const ChangeFilter& filter);
+
+    /// @brief Announce every valid status update again (default)
+    void clearChangeFilter() { mFilterEnabled = false; }
+
+    /// @brief Get the last received status of a registered inverter without polling it
+    ///
+    /// @param deviceID The device identifier of the inverter
+    /// @param status Status to fill
+    /// @return true If a status was received from this inverter
+    /// @return false If not or the inverter is not registered
+    bool getLastStatus(const uint32_t deviceID, InverterStatus& status) const;
+
+    /// @brief Get the last received compact status of a registered inverter without polling it
+    ///
+    /// @param deviceID The device identifier of the inverter
+    /// @param status Status to fill
+    /// @return true If a status was received from this inverter
+    /// @return false If not or the inverter is not registered
+    bool getLastStatus(const uint32_t deviceID, NETSGP::CompactStatus& status) const;
+
+    /// @brief Get the cached state of a registered inverter
+    ///
+    /// @param deviceID The device identifier of the inverter
+    /// @param info Info to fill
+    /// @return true If the inverter is registered
+    /// @return false If not
+    bool getInverterInfo(const uint32_t deviceID, InverterInfo& info) const;
+
+    /// @brief Clear the dirty flag of a registered inverter after consuming its change
+    ///
+    /// @param deviceID The device identifier of the inverter
+    void clearDirty(const uint32_t deviceID);
+
     /// @brief Register a new inverter to receive status updates
     ///
+    /// Inverters can be registered and deregistered at any time, also during a sweep.
     /// @param deviceID The device identifier of the inverter
-    void registerInverter(const uint32_t deviceID) { mDevices.insert(deviceID); }
+    /// @return true If the inverter is registered
+    /// @return false If the maximum amount of inverters is reached
+    bool registerInverter(const uint32_t deviceID) { return mDevices.insert(deviceID) != nullptr; }
 
     /// @brief Deregister an inverter to not receive status updates
     ///
     /// @param deviceID The device identifier of the inverter
     void deregisterInverter(const uint32_t deviceID) { mDevices.erase(deviceID); }
 
+    /// @brief Get the amount of registered inverters
+    size_t inverterCount() const { return mDevices.size(); }
+
+    /// @brief Send a STATUS request to any inverter right away, e.g. to find inverters
+    ///
+    /// The probe takes a free in flight slot like a regular request, so setMaxInFlight() and the single outstanding
+    /// request per inverter apply, but holds it only for timeoutMS. A timed out probe does not count against the
+    /// health of the inverter. A reply reaches the status listeners like any other, also after the slot was freed, and
+    /// is announced if the inverter is registered by then, see InverterDiscovery.
+    /// @param deviceID Unique device identifier, does not need to be registered
+    /// @param timeoutMS Time the probe holds its in flight slot in milliseconds
+    /// @return true If the request was sent
+    /// @return false If a RF module configuration is running, all in flight slots are taken or a request to the
+    /// inverter is outstanding
+    bool sendProbe(const uint32_t deviceID, const uint16_t timeoutMS = PROBE_TIMEOUT_MS);
+
+    /// @brief Get the amount of registered inverters that are offline
+    size_t offlineCount() const;
+
+    /// @brief Change the handling of unresponsive inverters and failed commands.
+    ///
+    /// After the first STATUS timeout an inverter is still polled in the next sweep, as single frames get lost. From
+    /// the second timeout in a row on it is skipped for backoffMS, doubling with every further timeout. After
+    /// offlineAfter timeouts in a row it is offline and only probed every probeIntervalMS. Probes are additionally
+    /// spaced so waiting for them takes at most probeSharePercent of the link time, no matter how many inverters are
+    /// offline. Any reply makes an inverter healthy again. Queued commands that time out or fail are retried
+    /// commandRetries times with exponential backoff, note that a retried reboot may reboot twice if only the reply
+    /// was lost.
+    /// @param policy Policy to use
+    void setHealthPolicy(const HealthPolicy& policy) { mHealth = policy; }
+
+    /// @brief Get the maximum amount of inverters that can be registered
+    size_t maxInverters() const { return mDevices.capacity(); }
+
+    /// @brief Queue a power grade change of the given inverter
+    ///
+    /// @param deviceID Unique device identifier
+    /// @param pg Power grade from 0-100% to set
+    /// @param callback Callback that gets called on completion, may be nullptr
+    /// @param priority Priority of the command, default is high
+    /// @param deadlineMS Drop the command if it could not be sent within this time in milliseconds, 0 for none
+    /// @return true If the command was queued
+    /// @return false If the queue is full
+    bool setPowerGradeAsync(const uint32_t deviceID, const PowerGrade pg, CommandCallback callback = nullptr,
+        const Priority priority = PRIORITY_HIGH, const uint32_t deadlineMS = 0);
+
+    /// @brief Queue activation or deactivation of the given inverter
+    ///
+    /// @param deviceID Unique device identifier
+    /// @param activate True to activate, false to deactivate
+    /// @param callback Callback that gets called on completion, may be nullptr
+    /// @param priority Priority of the command, default is normal
+    /// @param deadlineMS Drop the command if it could not be sent within this time in milliseconds, 0 for none
+    /// @return true If the command was queued
+    /// @return false If the queue is full
+    bool activateAsync(const uint32_t deviceID, const bool activate, CommandCallback callback = nullptr,
+        const Priority priority = PRIORITY_NORMAL, const uint32_t deadlineMS = 0);
+
+    /// @brief Queue a reboot of the given inverter
+    ///
+    /// @param deviceID Unique device identifier
+    /// @param callback Callback that gets called on completion, may be nullptr
+    /// @param priority Priority of the command, default is normal
+    /// @param deadlineMS Drop the command if it could not be sent within this time in milliseconds, 0 for none
+    /// @return true If the command was queued
+    /// @return false If the queue is full
+    bool rebootAsync(const uint32_t deviceID, CommandCallback callback = nullptr,
+        const Priority priority = PRIORITY_NORMAL, const uint32_t deadlineMS = 0);
+
+    /// @brief Get the amount of queued commands not yet sent
+    size_t queuedCommands() const;
+
+    /// @brief Fill a batch with all registered inverters and the given value, e.g. to curtail a whole group
+    ///
+    /// @param entries Entries to fill
+    /// @param capacity Amount of available entries
+    /// @param value Power grade or control value to set for all entries
+    /// @return size_t Amount of filled entries
+    size_t fillBatch(BatchEntry* entries, const size_t capacity, const uint8_t value) const;
+
+    /// @brief Start changing the power grades of many inverters, entry.value is the power grade to set.
+    ///
+    /// Batch entries are sent back to back as fast as replies arrive, after queued commands and before STATUS polling.
+    /// With setMaxInFlight() above 1 entries to different inverters are sent in parallel. Failed or timed out entries
+    /// are retried with exponential backoff. Only one batch can run at a time.
+    /// @param entries Entries of the batch, must stay valid until the batch completed or was cancelled
+    /// @param count Amount of entries
+    /// @param callback Callback that gets called once all entries are done, may be nullptr
+    /// @param maxAttempts Maximum amount of attempts per entry
+    /// @return true If the batch was started
+    /// @return false If another batch is running or the batch is empty
+    bool startPowerGradeBatch(
+        BatchEntry* entries, const size_t count, BatchCallback callback = nullptr, const uint8_t maxAttempts = 3);
+
+    /// @brief Start activating or deactivating many inverters, entry.value is overwritten.
+    ///
+    /// See startPowerGradeBatch() for scheduling and retries.
+    /// @param entries Entries of the batch, must stay valid until the batch completed or was cancelled
+    /// @param count Amount of entries
+    /// @param activate True to activate, false to deactivate
+    /// @param callback Callback that gets called once all entries are done, may be nullptr
+    /// @param maxAttempts Maximum amount of attempts per entry
+    /// @return true If the batch was started
+    /// @return false If another batch is running or the batch is empty
+    bool startActivateBatch(BatchEntry* entries, const size_t count, const bool activate,
+        BatchCallback callback = nullptr, const uint8_t maxAttempts = 3);
+
+    /// @brief Is a batch running
+    bool batchRunning() const { return mBatch != nullptr; }
+
+    /// @brief Stop the running batch without calling its callback, entries not done stay as they are
+    void cancelBatch();
+
+    /// @brief Change the settings of the RF module without blocking, see applyRFModuleSettings()
+    ///
+    /// Outstanding requests are completed first and no new ones are sent until the configuration is done. Programming
+    /// mode, the read and the optional write are then driven by update(). If the cached settings already match, the
+    /// callback is called right away.
+    /// @param settings Settings the RF module should have, the moduleID of the module is kept
+    /// @param callback Callback that gets called with the outcome and the settings of the module, may be nullptr
+    /// @return true If the configuration was started
+    /// @return false If another configuration is running
+    bool applyRFModuleSettingsAsync(const LC12S::Settings& settings, ConfigCallback callback = nullptr);
+
+    /// @brief Is a RF module configuration running
+    bool configuring() const { return mConfigState != CONFIG_IDLE; }
+
+    /// @brief Set how many requests may be outstanding at the same time, default is 1.
+    ///
+    /// With more than one, requests to different inverters are pipelined and replies are matched to their requests by
+    /// device identifier and command. Each request keeps its own timeout. There is never more than one request per
+    /// inverter outstanding. Only raise this as far as the radio can carry the overlapping replies.
+    /// @param maxInFlight Amount of outstanding requests, clamped to 1 - MAX_IN_FLIGHT
+    void setMaxInFlight(const uint8_t maxInFlight);
+
     /// @brief Update the internal state
     ///
+    /// Processes received replies and sends the next request as soon as the previous one was answered or timed out.
+    /// Queued commands are sent by priority, then by earliest deadline, then in queueing order. STATUS polling only
+    /// happens when no command is queued. Each inverter gets its own reply timeout derived from its measured reply
+    /// latency. Every call consumes received bytes, so garbage on the link can never stall it. The optional budgets
+    /// bound how long a single call takes, work left over is continued on the next call.
     /// @note Needs to be called inside loop()
-    void update();
+    /// @param maxFrames Maximum amount of replies to process in this call, 0 for no limit
+    /// @param maxMicros Maximum time in microseconds to spend processing replies, 0 for no limit
+    /// @return size_t Amount of received bytes still waiting to be processed
+    size_t update(const uint8_t maxFrames = 0, const uint32_t maxMicros = 0);
+
+    /// @brief Get the time until update() has work to do that does not depend on received data.
+    ///
+    /// Use it with an event driven stream (see NETSGP::EventStream) to sleep until either data arrives or a request
+    /// is due or times out, instead of spinning update().
+    /// @return uint32_t Milliseconds until the next request is due or times out, 0 if update() should be called now,
+    /// NO_ACTION if only received data can create work
+    uint32_t nextActionMS() const;
+
+private:
+    /// @brief Steps of a RF module configuration driven by update()
+    enum ConfigState
+    {
+        CONFIG_IDLE, /// No configuration running
+        CONFIG_DRAINING, /// Waiting for outstanding requests
+        CONFIG_ENTERING, /// Waiting for the RF module to enter programming mode
+        CONFIG_READING, /// Waiting for the read reply
+        CONFIG_WRITING, /// Waiting for the write reply
+    };
+
+    /// @brief A request that was queued or sent
+    struct Request
+    {
+        uint32_t deviceID; /// Recipient inverter identifier
+        Command command; /// Command to send
+        uint8_t value; /// Value to send
+        uint8_t priority; /// Priority, see Priority
+        bool used; /// Is this queue slot in use
+        bool hasDeadline; /// Does deadlineMS apply
+        uint32_t deadlineMS; /// Absolute time in milliseconds the command has to be sent by
+        uint32_t queuedMS; /// Time the command was queued
+        uint32_t sequence; /// Queueing order
+        uint8_t attempts; /// Amount of times the command was sent
+        CommandOutcome outcome; /// Outcome of the last attempt
+        uint32_t retryMS; /// Earliest time of the next attempt
+        CommandCallback callback; /// Completion callback, may be nullptr
+        BatchEntry* batchEntry; /// Batch entry this request belongs to, nullptr for queued commands
+        bool cancelled; /// Batch entry of a cancelled batch, its completion is dropped
+        bool probe; /// Probe sent with sendProbe(), its timeout does not count against the inverter
+    };
+
+    /// @brief Queue a command
+    bool queueCommand(const uint32_t deviceID, const Command command, const uint8_t value, CommandCallback callback,
+        const Priority priority, const uint32_t deadlineMS);
+
+    /// @brief A sent request waiting for its reply
+    struct InFlight
+    {
+        Request request; /// The sent request, request.used tells if this slot is in use
+        uint32_t sentMS; /// Send time in milliseconds
+        uint16_t timeoutMS; /// Reply timeout in milliseconds
+    };
+
+    /// @brief Find the outstanding request matching the reply in mBuffer
+    ///
+    /// @return InFlight* Matching request or nullptr
+    InFlight* findInFlight();
+
+    /// @brief Is a request to the given device outstanding
+    bool isInFlight(const uint32_t deviceID) const;
+
+    /// @brief Handle a STATUS reply in mBuffer
+    void handleStatusReply();
+
+    /// @brief Check if a status changed beyond the deadbands of the change filter
+    ///
+    /// @param status New status
+    /// @param reference Last announced status
+    /// @return true If the change has to be announced
+    /// @return false If not
+    bool exceedsChangeFilter(const NETSGP::CompactStatus& status, const NETSGP::CompactStatus& reference) const;
+
+    /// @brief Handle a CONTROL or POWER_GRADE reply in mBuffer
+    void handleCommandReply();
+
+    /// @brief Complete a command and notify its callback, or queue it again if it has retries left
+    ///
+    /// @param request Completed request
+    /// @param outcome Outcome of the last attempt
+    /// @param mayRetry False to report the outcome even with retries left, e.g. after the deadline passed
+    void completeCommand(const Request& request, const CommandOutcome outcome, const bool mayRetry = true);
+
+    /// @brief Is a request to this inverter allowed now, false while it is backing off or not due for a probe
+    bool pollDue(const DeviceRecord& record, const uint32_t currentMillis) const;
+
+    /// @brief Get the health of an inverter
+    Health healthOf(const DeviceRecord& record) const;
+
+    /// @brief Send the most important queued command whose device has no outstanding request
+    ///
+    /// @param currentMillis Current time in milliseconds
+    /// @param slot Free in flight slot to use
+    /// @return true If a command was sent
+    /// @return false If no command can be sent
+    bool sendNextCommand(const uint32_t currentMillis, InFlight& slot);
+
+    /// @brief Start a batch
+    bool startBatch(BatchEntry* entries, const size_t count, const Command command, BatchCallback callback,
+        const uint8_t maxAttempts);
+
+    /// @brief Record the outcome of an attempt of a batch entry and finish the batch when all entries are done
+    void completeBatchEntry(BatchEntry& entry, const CommandOutcome outcome);
+
+    /// @brief Get the wait before retrying a command, BATCH_BACKOFF_MS doubled for every attempt after the first
+    ///
+    /// @param attempts Amount of times the command was sent
+    /// @return uint32_t Wait in milliseconds, the doubling stops after 16 steps
+    static uint32_t retryBackoffMS(const uint8_t attempts);
+
+    /// @brief Send the next due batch entry whose device has no outstanding request
+    ///
+    /// @param currentMillis Current time in milliseconds
+    /// @param slot Free in flight slot to use
+    /// @return true If a batch entry was sent
+    /// @return false If no batch entry can be sent
+    bool sendNextBatchEntry(const uint32_t currentMillis, InFlight& slot);
+
+    /// @brief Send the next STATUS request if a sweep is running or due
+    ///
+    /// @param currentMillis Current time in milliseconds
+    /// @param slot Free in flight slot to use
+    /// @return true If a request was sent
+    /// @return false If not
+    bool sendNextStatusRequest(const uint32_t currentMillis, InFlight& slot);
+
+    /// @brief Send the request in the given slot and wait for its reply
+    void sendRequest(const uint32_t currentMillis, InFlight& slot);
+
+    /// @brief Advance the running RF module configuration
+    void updateConfig(const uint32_t currentMillis);
+
+    /// @brief Send a configuration frame and wait for its reply
+    void sendConfigFrame(const uint32_t currentMillis, const uint8_t command, const LC12S::Settings& settings);
+
+    /// @brief Leave programming mode and notify the configuration callback
+    void finishConfig(const bool success);
 
 private:
+    constexpr static const uint16_t MAX_TIMEOUT_MS = 1000; /// Reply timeout used before the latency is known
+    constexpr static const uint16_t MIN_TIMEOUT_MARGIN_MS = 30; /// Minimum margin above the smoothed latency
+    constexpr static const size_t MAX_QUEUED_COMMANDS = 8; /// Maximum amount of queued commands
+    constexpr static const uint16_t BATCH_BACKOFF_MS = 50; /// Wait before the first retry, doubles on each retry
+    constexpr static const uint16_t CONFIG_TIMEOUT_MS = 1000; /// Reply timeout of RF module configuration frames
+
     uint16_t mIntervalMS; /// Update interval in milliseconds
-    uint32_t mLastUpdateMS; /// Last update time in milliseconds
-    uint32_t mLastSendMS; /// Makes sure we do not send to often
-    bool mCanSend = true; /// Can the next message be sent?
-    std::set<uint32_t> mDevices; /// All devices to poll
-    std::set<uint32_t>::iterator mDeviceIte; /// Set iterator to know which device to poll
+    uint32_t mLastSweepMS; /// Start time of the last sweep over all devices
+    bool mSweeping = false; /// Is a sweep over all devices running
+    uint32_t mNextDeviceID = 0; /// Poll the first device with an identifier not less than this one next
+    uint8_t mMaxInFlight = 1; /// Maximum amount of outstanding requests
+    HealthPolicy mHealth; /// Handling of unresponsive inverters and failed commands
+    uint32_t mLastProbeMS = 0; /// Time the last offline inverter was probed
+    uint32_t mProbeGapMS = 0; /// Pause after the last probe to stay within HealthPolicy::probeSharePercent
+    InFlight mInFlight[MAX_IN_FLIGHT] = {}; /// Outstanding requests
+    Request mQueue[MAX_QUEUED_COMMANDS] = {}; /// Queued commands
+    uint32_t mSequence = 0; /// Queueing order of the next command
+    BatchEntry* mBatch = nullptr; /// Entries of the running batch, nullptr if none
+    size_t mBatchCount = 0; /// Amount of entries in the running batch
+    size_t mBatchRemaining = 0; /// Amount of entries not yet done
+    Command mBatchCommand = Command::POWER_GRADE; /// Command of the running batch
+    uint8_t mBatchMaxAttempts = 0; /// Maximum amount of attempts per entry
+    uint32_t mBatchStartMS = 0; /// Start time of the running batch
+    BatchCallback mBatchCallback = nullptr; /// Callback for the completed batch
+    ConfigState mConfigState = CONFIG_IDLE; /// Step of the running RF module configuration
+    LC12S::Settings mConfigTarget = {}; /// Settings the RF module should get
+    ConfigCallback mConfigCallback = nullptr; /// Callback for the completed configuration
+    uint32_t mConfigMS = 0; /// Start time of the current configuration step
+    uint8_t mConfigReceived = 0; /// Bytes of the configuration reply received so far
+    NETSGP::DeviceRegistry<DeviceRecord> mDevices; /// All devices to poll
     InverterStatusCallback mCallback = nullptr; /// Callback for status updates
+    CompactStatusCallback mCompactCallback = nullptr; /// Callback for compact status updates
+    CommandListener* mCommandListener = nullptr; /// Listener for all completed commands
+    NETSGP::StatusListener* mListeners[MAX_STATUS_LISTENERS] = {}; /// Listeners for every valid status
+    bool mFilterEnabled = false; /// Are status updates filtered by the deadbands
+    uint16_t mVoltageDeadband = 0; /// Voltage deadband in centivolts
+    uint16_t mCurrentDeadband = 0; /// Current deadband in centiamperes
+    uint32_t mPowerDeadband = 0; /// Power deadband in 1/10000 Watts
+    float mTotalDeadband = 0.0f; /// Total generated power deadband
+    uint8_t mTemperatureDeadband = 0; /// Temperature deadband
+    uint32_t mMaxSilenceMS = 0; /// Forced announcement interval, 0 for none
 };
+
+/// @brief Async version of NETSGPClient with storage for a fixed maximum amount of inverters
+///
+/// @tparam MaxInverters Maximum amount of inverters that can be registered
+template <size_t MaxInverters>
+class BasicAsyncNETSGPClient : public AsyncNETSGPClientBase
+{
+public:
+    /// @brief Construct a new BasicAsyncNETSGPClient object.
+    ///
+    /// @param stream Stream to communicate with the RF module
+    /// @param progPin Programming enable pin of RF module (active low)
+    /// @param interval The update interval in seconds, default is 2 seconds
+    BasicAsyncNETSGPClient(Stream& stream, const uint8_t progPin, const uint8_t interval = 2)
+        : AsyncNETSGPClientBase(stream, progPin, interval, &mStorage[0], MaxInverters)
+    { }
+
+private:
+    DeviceRecord mStorage[MaxInverters]; /// Storage of the device registry
+};
+
+/// @brief Async version of NETSGPClient for up to 16 inverters
+typedef BasicAsyncNETSGPClient<16> AsyncNETSGPClient;
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVR__)
+// No <atomic> on AVR, but single byte loads and stores are atomic and there is only one core
+#define NETSGP_RING_ATOMIC 0
+#else
+#include <atomic>
+#define NETSGP_RING_ATOMIC 1
+#endif
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Free running index of a ring shared between one producer and one consumer
+    class RingIndex
+    {
+    public:
+#if NETSGP_RING_ATOMIC
+        typedef uint32_t Value; /// Index type
+#else
+        typedef uint8_t Value; /// Index type
+#endif
+
+        Value loadRelaxed() const
+        {
+#if NETSGP_RING_ATOMIC
+            return mValue.load(std::memory_order_relaxed);
+#else
+            return mValue;
+#endif
+        }
+
+        Value loadAcquire() const
+        {
+#if NETSGP_RING_ATOMIC
+            return mValue.load(std::memory_order_acquire);
+#else
+            return mValue;
+#endif
+        }
+
+        void storeRelease(const Value value)
+        {
+#if NETSGP_RING_ATOMIC
+            mValue.store(value, std::memory_order_release);
+#else
+            mValue = value;
+#endif
+        }
+
+    private:
+#if NETSGP_RING_ATOMIC
+        std::atomic<Value> mValue {0};
+#else
+        volatile Value mValue = 0;
+#endif
+    };
+
+    /// @brief Lock-free single producer single consumer byte ring, see ByteRing for an instantiable variant
+    ///
+    /// The producer (an UART RX interrupt, event callback or thread) only calls push() and the consumer (the client)
+    /// only calls pop() and peek(). Neither side ever blocks or disables interrupts. Bytes pushed into a full ring are
+    /// dropped and counted, see overflows().
+    class ByteRingBase
+    {
+    public:
+        typedef RingIndex::Value Index; /// Free running index type
+
+    protected:
+        /// @brief Construct a new ByteRingBase object
+        ///
+        /// @param storage Storage for the bytes, only its address is used during construction
+        /// @param capacity Size of storage, must be a power of two
+        ByteRingBase(uint8_t* storage, const size_t capacity) : mStorage(storage), mMask(capacity - 1) { }
+
+    public:
+        ByteRingBase(const ByteRingBase&) = delete;
+        ByteRingBase& operator=(const ByteRingBase&) = delete;
+
+        /// @brief Push a byte, producer side only
+        ///
+        /// @return true If the byte was stored
+        /// @return false If the ring is full and the byte was dropped
+        bool push(const uint8_t byte)
+        {
+            const Index head = mHead.loadRelaxed();
+            if (static_cast<Index>(head - mTail.loadAcquire()) > mMask)
+            {
+                ++mOverflows;
+                return false;
+            }
+            mStorage[head & mMask] = byte;
+            mHead.storeRelease(head + 1);
+            return true;
+        }
+
+        /// @brief Push many bytes, producer side only
+        ///
+        /// @return size_t Amount of stored bytes, the rest was dropped
+        size_t push(const uint8_t* data, const size_t length)
+        {
+            const Index head = mHead.loadRelaxed();
+            const size_t space = mMask + 1 - static_cast<Index>(head - mTail.loadAcquire());
+            const size_t count = length < space ? length : space;
+            for (size_t i = 0; i < count; ++i)
+            {
+                mStorage[(head + i) & mMask] = data[i];
+            }
+            mHead.storeRelease(head + count);
+            mOverflows += length - count;
+            return count;
+        }
+
+        /// @brief Pop a byte, consumer side only
+        ///
+        /// @return int The byte or -1 if the ring is empty
+        int pop()
+        {
+            const Index tail = mTail.loadRelaxed();
+            if (mHead.loadAcquire() == tail)
+            {
+                return -1;
+            }
+            const uint8_t byte = mStorage[tail & mMask];
+            mTail.storeRelease(tail + 1);
+            return byte;
+        }
+
+        /// @brief Get the next byte without removing it, consumer side only
+        ///
+        /// @return int The byte or -1 if the ring is empty
+        int peek() const
+        {
+            const Index tail = mTail.loadRelaxed();
+            return mHead.loadAcquire() == tail ? -1 : mStorage[tail & mMask];
+        }
+
+        /// @brief Get the amount of stored bytes, exact on the consumer side, a lower bound on the producer side
+        size_t size() const { return static_cast<Index>(mHead.loadAcquire() - mTail.loadAcquire()); }
+
+        /// @brief Is the ring empty
+        bool empty() const { return size() == 0; }
+
+        /// @brief Get the maximum amount of stored bytes
+        size_t capacity() const { return mMask + 1; }
+
+        /// @brief Get the amount of bytes dropped because the ring was full
+        uint32_t overflows() const { return mOverflows; }
+
+    private:
+        uint8_t* mStorage; /// Byte storage
+        Index mMask; /// Capacity - 1
+        RingIndex mHead; /// Index the next byte is pushed to, written by the producer only
+        RingIndex mTail; /// Index the next byte is popped from, written by the consumer only
+        volatile uint32_t mOverflows = 0; /// Dropped bytes, written by the producer only
+    };
+
+    /// @brief Lock-free single producer single consumer byte ring with fixed capacity
+    ///
+    /// @tparam Capacity Maximum amount of stored bytes, must be a power of two
+    template <size_t Capacity>
+    class ByteRing : public ByteRingBase
+    {
+        static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+        static_assert(Capacity < (static_cast<uint64_t>(1) << (8 * sizeof(Index))), "Capacity too large for Index");
+
+    public:
+        ByteRing() : ByteRingBase(&mBuffer[0], Capacity) { }
+
+    private:
+        uint8_t mBuffer[Capacity]; /// Byte storage
+    };
+} // namespace NETSGP
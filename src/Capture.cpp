@@ -0,0 +1,209 @@
+#include "Capture.h"
+
+#include <string.h>
+
+#include <Arduino.h>
+
+namespace NETSGP
+{
+    bool CaptureStream::begin()
+    {
+        const uint8_t header[CaptureFormat::HEADER_SIZE] = {CaptureFormat::MAGIC[0], CaptureFormat::MAGIC[1],
+            CaptureFormat::MAGIC[2], CaptureFormat::MAGIC[3], CaptureFormat::VERSION};
+        if (mLog.write(header, sizeof(header)) != sizeof(header))
+        {
+            return false;
+        }
+        mLength = 0;
+        mPreviousMicros = micros();
+        mCapturing = true;
+        return true;
+    }
+
+    void CaptureStream::end()
+    {
+        flushRecord();
+        mCapturing = false;
+    }
+
+    void CaptureStream::flushRecord()
+    {
+        if (mLength == 0)
+        {
+            return;
+        }
+
+        // Head, varint of up to five bytes and payload go out in one write
+        uint8_t buffer[1 + 5 + CaptureFormat::MAX_RECORD];
+        size_t size = 0;
+        buffer[size++] = (mSent ? CaptureFormat::TX_FLAG : 0) | mLength;
+        uint32_t delta = mLastByteMicros - mPreviousMicros;
+        do
+        {
+            buffer[size++] = (delta & 0x7F) | (delta > 0x7F ? 0x80 : 0);
+            delta >>= 7;
+        } while (delta);
+        memcpy(&buffer[size], mPayload, mLength);
+        size += mLength;
+
+        if (mLog.write(buffer, size) == size)
+        {
+            ++mRecords;
+            mPreviousMicros = mLastByteMicros;
+        }
+        else
+        {
+            mDroppedBytes += mLength;
+        }
+        mLength = 0;
+    }
+
+    int CaptureStream::read()
+    {
+        const int byte = mStream.read();
+        if (byte >= 0 && mCapturing)
+        {
+            const uint8_t data = byte;
+            record(false, &data, 1);
+        }
+        return byte;
+    }
+
+    size_t CaptureStream::write(const uint8_t* buffer, size_t size)
+    {
+        const size_t written = mStream.write(buffer, size);
+        if (mCapturing)
+        {
+            record(true, buffer, written);
+        }
+        return written;
+    }
+
+    void CaptureStream::record(const bool sent, const uint8_t* data, const size_t length)
+    {
+        const uint32_t currentMicros = micros();
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (mLength
+                && (sent != mSent || mLength >= CaptureFormat::MAX_RECORD
+                    || currentMicros - mLastByteMicros > CaptureFormat::MAX_GAP_US))
+            {
+                flushRecord();
+            }
+            mSent = sent;
+            mPayload[mLength++] = data[i];
+            mLastByteMicros = currentMicros;
+        }
+    }
+
+    bool ReplayStream::begin()
+    {
+        start();
+        return mValid;
+    }
+
+    void ReplayStream::start()
+    {
+        if (mStarted)
+        {
+            return;
+        }
+        mStarted = true;
+        mLastMicros = micros();
+        uint8_t header[CaptureFormat::HEADER_SIZE];
+        mValid = mCapture.readBytes(header, sizeof(header)) == sizeof(header)
+            && memcmp(header, CaptureFormat::MAGIC, sizeof(CaptureFormat::MAGIC)) == 0
+            && header[4] == CaptureFormat::VERSION;
+        mEnded = !mValid;
+    }
+
+    int ReplayStream::read()
+    {
+        if (!fill())
+        {
+            return -1;
+        }
+        ++mPlayed;
+        return mPayload[mPosition++];
+    }
+
+    bool ReplayStream::fill()
+    {
+        if (mPosition < mLength)
+        {
+            return true;
+        }
+        start();
+        const uint32_t currentMicros = micros();
+        // Advanced in small steps, so neither the speed nor long captures overflow
+        mPlayMicros += static_cast<uint32_t>((currentMicros - mLastMicros) * mSpeed);
+        mLastMicros = currentMicros;
+
+        while (!mEnded)
+        {
+            if (!mHasHead && !readHead())
+            {
+                mEnded = true;
+                return false;
+            }
+            if (mNextSent)
+            {
+                // What the client sent back then is not played back, only skipped
+                for (uint8_t i = 0; i < mNextLength; ++i)
+                {
+                    mCapture.read();
+                }
+                mRecordedSent += mNextLength;
+                mHasHead = false;
+                continue;
+            }
+            if (mSpeed > 0 && mPlayMicros < mNextMicros)
+            {
+                return false;
+            }
+            mLength = mCapture.readBytes(mPayload, mNextLength);
+            mPosition = 0;
+            mHasHead = false;
+            if (mLength < mNextLength)
+            {
+                mEnded = true;
+            }
+            return mLength > 0;
+        }
+        return false;
+    }
+
+    bool ReplayStream::readHead()
+    {
+        const int head = mCapture.read();
+        uint32_t delta;
+        if (head < 0 || !readVarint(delta))
+        {
+            return false;
+        }
+        mNextSent = head & CaptureFormat::TX_FLAG;
+        mNextLength = head & ~CaptureFormat::TX_FLAG;
+        mNextMicros += delta;
+        mHasHead = mNextLength > 0 && mNextLength <= CaptureFormat::MAX_RECORD;
+        return mHasHead;
+    }
+
+    bool ReplayStream::readVarint(uint32_t& value)
+    {
+        value = 0;
+        for (uint8_t shift = 0; shift < 35; shift += 7)
+        {
+            const int byte = mCapture.read();
+            if (byte < 0)
+            {
+                return false;
+            }
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+} // namespace NETSGP
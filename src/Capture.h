@@ -0,0 +1,178 @@
+#pragma once
+
+#include <Stream.h>
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Binary capture format shared by CaptureStream and ReplayStream
+    ///
+    /// A capture starts with the five byte header 'N' 'S' 'G' 'C' VERSION followed by records. Every record starts with
+    /// one byte holding the direction in bit 7 (1 = sent to the RF module, 0 = received from it) and the payload length
+    /// (1 - MAX_RECORD) in bits 0 - 6, followed by the time of its last byte in microseconds since the last byte of the
+    /// previous record (or the start of the capture) as unsigned LEB128 varint and the payload. A frame thus replays
+    /// exactly when the client had all of it. A received reply typically costs three bytes on top of its payload.
+    /// Records are only ever appended, so a capture cut short by a reset is still readable up to its last complete
+    /// record.
+    namespace CaptureFormat
+    {
+        constexpr static const uint8_t MAGIC[4] = {'N', 'S', 'G', 'C'}; /// Start of every capture
+        constexpr static const uint8_t VERSION = 1; /// Format version
+        constexpr static const uint8_t HEADER_SIZE = 5; /// Size of the capture header
+        constexpr static const uint8_t TX_FLAG = 0x80; /// Direction bit of the record head, set for sent bytes
+        constexpr static const uint8_t MAX_RECORD = 64; /// Maximum payload of one record
+        constexpr static const uint32_t MAX_GAP_US = 2000; /// Bytes further apart than this start a new record
+    } // namespace CaptureFormat
+
+    /// @brief Stream tap recording all bytes between a client and its RF module, see CaptureFormat
+    ///
+    /// Pass it to NETSGPClient or AsyncNETSGPClient instead of the UART. Bytes in the same direction are collected
+    /// into one record as long as they follow each other closely, so every frame usually becomes one record. Received
+    /// bytes are stamped when the client reads them, which is exactly what the client saw. The log can be any Print,
+    /// e.g. a File on SD or LittleFS, and should buffer writes itself.
+    class CaptureStream : public Stream
+    {
+    public:
+        /// @brief Construct a new CaptureStream object, capturing starts with begin()
+        ///
+        /// @param stream Stream connected to the RF module
+        /// @param log Destination of the capture
+        CaptureStream(Stream& stream, Print& log) : mStream(stream), mLog(log) { }
+
+        /// @brief Write the capture header and start capturing
+        ///
+        /// @return true If the header was written
+        /// @return false If the log did not take it
+        bool begin();
+
+        /// @brief Write the pending record and stop capturing
+        void end();
+
+        /// @brief Write the pending record to the log, e.g. before flushing the log
+        void flushRecord();
+
+        /// @brief Is capturing running
+        bool capturing() const { return mCapturing; }
+
+        /// @brief Get the amount of records written
+        uint32_t records() const { return mRecords; }
+
+        /// @brief Get the amount of payload bytes lost because the log did not take them
+        uint32_t droppedBytes() const { return mDroppedBytes; }
+
+        int available() override { return mStream.available(); }
+        int read() override;
+        int peek() override { return mStream.peek(); }
+        size_t write(uint8_t byte) override { return write(&byte, 1); }
+        size_t write(const uint8_t* buffer, size_t size) override;
+        void flush() override { mStream.flush(); }
+        using Print::write;
+
+    private:
+        /// @brief Add bytes to the pending record, writing it out first if they do not belong to it
+        void record(const bool sent, const uint8_t* data, const size_t length);
+
+    private:
+        Stream& mStream; /// Stream connected to the RF module
+        Print& mLog; /// Destination of the capture
+        bool mCapturing = false; /// Is capturing running
+        bool mSent = false; /// Direction of the pending record
+        uint8_t mLength = 0; /// Payload bytes in the pending record
+        uint8_t mPayload[CaptureFormat::MAX_RECORD]; /// Payload of the pending record
+        uint32_t mLastByteMicros = 0; /// Time of the last byte in the pending record
+        uint32_t mPreviousMicros = 0; /// Time of the last byte of the previous record or the start of the capture
+        uint32_t mRecords = 0; /// Records written
+        uint32_t mDroppedBytes = 0; /// Payload bytes the log did not take
+    };
+
+    /// @brief Stream playing the received bytes of a capture back to a client, see CaptureFormat
+    ///
+    /// Pass it to NETSGPClient or AsyncNETSGPClient instead of the UART. Received bytes become available at their
+    /// recorded time relative to begin() or the first access, scaled by the speed, or all at once with speed 0. Bytes
+    /// written by the client are only counted, recorded sent bytes are skipped and counted too, so a regression can
+    /// compare both. At original speed the client sends exactly what was recorded, faster playback is meant for
+    /// feeding status listeners, as the timeouts of the client do not scale.
+    class ReplayStream : public Stream
+    {
+    public:
+        /// @brief Construct a new ReplayStream object.
+        ///
+        /// @param capture Stream to read the capture from, e.g. a File
+        /// @param speed Playback speed, 1 for original timing, 10 for ten times faster, 0 for no delays at all
+        ReplayStream(Stream& capture, const float speed = 1.0f) : mCapture(capture), mSpeed(speed) { }
+
+        /// @brief Read the capture header and start playback now, otherwise this happens on the first access
+        ///
+        /// @return true If the capture header is valid
+        /// @return false If not
+        bool begin();
+
+        /// @brief Is the capture header valid, only known after begin() or the first access
+        bool valid() const { return mValid; }
+
+        /// @brief Was the whole capture played back and read by the client
+        bool finished() const { return mEnded && mPosition >= mLength; }
+
+        /// @brief Get the amount of recorded sent bytes that were skipped
+        uint32_t recordedSentBytes() const { return mRecordedSent; }
+
+        /// @brief Get the amount of bytes written by the client
+        uint32_t writtenBytes() const { return mWritten; }
+
+        /// @brief Get the amount of received bytes played back
+        uint32_t playedBytes() const { return mPlayed; }
+
+        int available() override { return fill() ? mLength - mPosition : 0; }
+        int read() override;
+        int peek() override { return fill() ? mPayload[mPosition] : -1; }
+        size_t write(uint8_t) override
+        {
+            ++mWritten;
+            return 1;
+        }
+        size_t write(const uint8_t*, size_t size) override
+        {
+            mWritten += size;
+            return size;
+        }
+        using Print::write;
+
+    private:
+        /// @brief Read the capture header and start playback if this did not happen yet
+        void start();
+
+        /// @brief Make the next due received record available if the current one is used up
+        ///
+        /// @return true If received bytes are available
+        /// @return false If not
+        bool fill();
+
+        /// @brief Read the head of the next record
+        ///
+        /// @return true If a record head was read
+        /// @return false If the capture ended
+        bool readHead();
+
+        /// @brief Read an unsigned LEB128 varint from the capture
+        bool readVarint(uint32_t& value);
+
+    private:
+        Stream& mCapture; /// Stream to read the capture from
+        float mSpeed; /// Playback speed, 0 for no delays
+        bool mStarted = false; /// Was the header read
+        bool mValid = false; /// Is the header valid
+        bool mEnded = false; /// Did the capture end
+        bool mHasHead = false; /// Was the head of the next record read
+        bool mNextSent = false; /// Direction of the next record
+        uint8_t mNextLength = 0; /// Payload length of the next record
+        uint64_t mNextMicros = 0; /// Time of the next record since the start of the capture
+        uint64_t mPlayMicros = 0; /// Playback time since the first access, scaled by the speed
+        uint32_t mLastMicros = 0; /// Time playback time was last advanced
+        uint8_t mPayload[CaptureFormat::MAX_RECORD]; /// Payload of the current received record
+        uint8_t mLength = 0; /// Length of the current received record
+        uint8_t mPosition = 0; /// Bytes of the current received record already read
+        uint32_t mRecordedSent = 0; /// Recorded sent bytes that were skipped
+        uint32_t mWritten = 0; /// Bytes written by the client
+        uint32_t mPlayed = 0; /// Received bytes played back
+    };
+} // namespace NETSGP
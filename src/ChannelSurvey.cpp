@@ -0,0 +1,206 @@
+#include "ChannelSurvey.h"
+
+#include <string.h>
+
+#include <Arduino.h>
+
+ChannelSurvey::ChannelSurvey(AsyncNETSGPClientBase& client)
+    : mClient(client), mListening(client.addStatusListener(*this))
+{ }
+
+ChannelSurvey::~ChannelSurvey()
+{
+    mClient.removeStatusListener(*this);
+}
+
+bool ChannelSurvey::setChannels(const uint8_t* channels, const size_t count)
+{
+    if (mState != SURVEY_IDLE)
+    {
+        return false;
+    }
+    mChannelCount = count < MAX_CHANNELS ? count : MAX_CHANNELS;
+    for (size_t i = 0; i < mChannelCount; ++i)
+    {
+        mResults[i] = {};
+        mResults[i].channel = channels[i];
+    }
+    return true;
+}
+
+bool ChannelSurvey::start()
+{
+    if (mState != SURVEY_IDLE || mChannelCount == 0 || mClient.configuring())
+    {
+        return false;
+    }
+    // Without status callbacks every channel would count zero inverters, try again in case a slot became free
+    mListening = mListening || mClient.addStatusListener(*this);
+    if (!mListening)
+    {
+        DEBUGLN("[ChannelSurvey] No free status listener slot");
+        return false;
+    }
+    const LC12S::Settings& settings = mClient.getCachedRFModuleSettings();
+    if (settings.valid)
+    {
+        mChannel = settings.rfChannel;
+    }
+    for (size_t i = 0; i < mChannelCount; ++i)
+    {
+        const uint8_t channel = mResults[i].channel;
+        mResults[i] = {};
+        mResults[i].channel = channel;
+    }
+    ++mSurveys;
+    mIndex = 0;
+    next();
+    return true;
+}
+
+void ChannelSurvey::update()
+{
+    const uint32_t currentMillis = millis();
+    switch (mState)
+    {
+    case SURVEY_IDLE:
+    {
+        if (currentMillis - mStepMS < mTuning.checkIntervalMS)
+        {
+            break;
+        }
+        const NETSGPClient::LinkStatistics stats = mClient.getStatistics();
+        const uint32_t replies = stats.replies - mBaseReplies;
+        const uint32_t attempts = replies + stats.timeouts - mBaseTimeouts;
+        if (attempts < mTuning.minAttempts)
+        {
+            break;
+        }
+        if (replies * 100000ULL < static_cast<uint64_t>(attempts) * mTuning.minSuccessPercent * mExpectedPermille
+            && start())
+        {
+            DEBUGF("[ChannelSurvey] Reply success %u%%, surveying\n", replies * 100 / attempts);
+            break;
+        }
+        takeBaseline();
+        break;
+    }
+    case SURVEY_TUNING:
+    case SURVEY_FINISHING:
+        if (mClient.configuring())
+        {
+            break;
+        }
+        if (mState == SURVEY_FINISHING)
+        {
+            mState = SURVEY_IDLE;
+            takeBaseline();
+        }
+        else if (mClient.getCachedRFModuleSettings().rfChannel == mTuningChannel)
+        {
+            mState = SURVEY_DWELLING;
+            takeBaseline();
+        }
+        else
+        {
+            // The module could not be tuned, leave this channel unmeasured
+            ++mIndex;
+            next();
+        }
+        break;
+    case SURVEY_DWELLING:
+        if (currentMillis - mStepMS >= mTuning.dwellMS)
+        {
+            const uint32_t elapsedMS = currentMillis - mStepMS;
+            const NETSGPClient::LinkStatistics stats = mClient.getStatistics();
+            ChannelResult& result = mResults[mIndex];
+            result.measured = true;
+            result.replies = stats.replies - mBaseReplies;
+            result.timeouts = stats.timeouts - mBaseTimeouts;
+            result.repliesPerMinute = static_cast<uint64_t>(result.replies) * 60000 / (elapsedMS ? elapsedMS : 1);
+            for (const uint8_t bits : mReached)
+            {
+                for (uint8_t b = bits; b; b &= b - 1)
+                {
+                    ++result.inverters;
+                }
+            }
+            DEBUGF("[ChannelSurvey] Channel %u: %u replies, %u timeouts\n", result.channel, result.replies,
+                result.timeouts);
+            ++mIndex;
+            next();
+        }
+        break;
+    }
+}
+
+void ChannelSurvey::onStatus(const NETSGP::CompactStatus& status, const uint32_t)
+{
+    if (mState == SURVEY_DWELLING)
+    {
+        // Fibonacci hashing spreads sequential identifiers evenly, collisions only make the count a bit low
+        const uint8_t hash = (status.deviceID * 2654435769UL) >> 24;
+        mReached[hash >> 3] |= 1 << (hash & 7);
+    }
+}
+
+bool ChannelSurvey::tune(const uint8_t channel)
+{
+    LC12S::Settings settings = mClient.getCachedRFModuleSettings();
+    if (!settings.valid)
+    {
+        settings = LC12S::DEFAULT_SETTINGS;
+    }
+    settings.rfChannel = channel;
+    mTuningChannel = channel;
+    return mClient.applyRFModuleSettingsAsync(settings);
+}
+
+void ChannelSurvey::next()
+{
+    if (mIndex < mChannelCount)
+    {
+        mState = SURVEY_TUNING;
+        if (!tune(mResults[mIndex].channel))
+        {
+            ++mIndex;
+            next();
+        }
+        return;
+    }
+
+    // Prefer the previous channel on a tie, so equal channels do not cause needless writes
+    const ChannelResult* best = nullptr;
+    for (size_t i = 0; i < mChannelCount; ++i)
+    {
+        const ChannelResult& result = mResults[i];
+        if (result.measured
+            && (!best || result.inverters > best->inverters
+                || (result.inverters == best->inverters
+                    && (result.repliesPerMinute > best->repliesPerMinute
+                        || (result.repliesPerMinute == best->repliesPerMinute && result.channel == mChannel)))))
+        {
+            best = &result;
+        }
+    }
+    if (best && best->replies > 0)
+    {
+        mChannel = best->channel;
+        mExpectedPermille = best->replies * 1000ULL / (best->replies + best->timeouts);
+    }
+    mState = SURVEY_FINISHING;
+    if (!tune(mChannel))
+    {
+        mState = SURVEY_IDLE;
+        takeBaseline();
+    }
+}
+
+void ChannelSurvey::takeBaseline()
+{
+    const NETSGPClient::LinkStatistics stats = mClient.getStatistics();
+    mBaseReplies = stats.replies;
+    mBaseTimeouts = stats.timeouts;
+    mStepMS = millis();
+    memset(mReached, 0, sizeof(mReached));
+}
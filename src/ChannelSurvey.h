@@ -0,0 +1,129 @@
+#pragma once
+
+#include "AsyncNETSGPClient.h"
+#include "StatusListener.h"
+
+/// @brief Finds the RF channel with the highest STATUS reply rate and keeps watching it
+///
+/// A survey tunes the RF module to every candidate channel in turn with
+/// AsyncNETSGPClient::applyRFModuleSettingsAsync(), lets the client poll all registered inverters for dwellMS and
+/// counts replies and timeouts. The channel reaching the most inverters wins, ties are broken by the most replies per
+/// minute, which accounts for both reply success and latency. Between surveys the reply success on the chosen channel
+/// is checked every checkIntervalMS and a new survey starts when it falls below minSuccessPercent of what the last
+/// survey measured there, so inverters that are out of reach on every channel do not cause endless surveys.
+/// @note The protocol has no command to retune an inverter, every inverter stays on the channel it was built for. A
+/// survey can therefore only find the channel the inverters actually listen on (e.g. after the module lost its settings
+/// or when inverters of different batches use different channels), it cannot move the fleet to a quieter channel.
+class ChannelSurvey : public NETSGP::StatusListener
+{
+public:
+    /// @brief Tuning of the survey
+    struct Tuning
+    {
+        uint32_t dwellMS = 10000; /// Time spent measuring each channel in milliseconds
+        uint32_t checkIntervalMS = 60000; /// Time between two checks of the chosen channel in milliseconds
+        uint8_t minSuccessPercent = 70; /// Start a survey if the reply success falls below this share of the
+                                        /// success the last survey measured on the chosen channel
+        uint8_t minAttempts = 10; /// Minimum amount of requests before the reply success is judged
+    };
+
+    /// @brief Measurement of one candidate channel in the last survey
+    struct ChannelResult
+    {
+        uint8_t channel; /// RF channel (0 - 127)
+        bool measured; /// Was the channel measured, false if the module could not be tuned to it
+        uint32_t replies; /// Replies received while dwelling on the channel
+        uint32_t timeouts; /// Requests that timed out while dwelling on the channel
+        uint32_t repliesPerMinute; /// Replies per minute while dwelling on the channel
+        uint16_t inverters; /// Inverters that replied at least once while dwelling on the channel
+    };
+
+    constexpr static const size_t MAX_CHANNELS = 16; /// Maximum amount of candidate channels
+
+public:
+    /// @brief Construct a new ChannelSurvey object and add it as status listener of the client
+    ///
+    /// @param client Client whose RF module is tuned, its registered inverters are used for measuring
+    explicit ChannelSurvey(AsyncNETSGPClientBase& client);
+
+    /// @brief Remove the survey from the status listeners of the client
+    ~ChannelSurvey();
+
+    ChannelSurvey(const ChannelSurvey&) = delete;
+    ChannelSurvey& operator=(const ChannelSurvey&) = delete;
+
+    /// @brief Set the candidate channels, only while no survey is running
+    ///
+    /// @param channels RF channels (0 - 127) to survey
+    /// @param count Amount of channels, at most MAX_CHANNELS are used
+    /// @return true If the channels were set
+    /// @return false If a survey is running
+    bool setChannels(const uint8_t* channels, const size_t count);
+
+    /// @brief Change the tuning of the survey
+    void setTuning(const Tuning& tuning) { mTuning = tuning; }
+
+    /// @brief Start a survey now
+    ///
+    /// @return true If the survey was started
+    /// @return false If a survey or another RF module configuration is running, there are no candidate channels or
+    /// the survey is no status listener of the client because all MAX_STATUS_LISTENERS slots are taken
+    bool start();
+
+    /// @brief Is a survey running
+    bool surveying() const { return mState != SURVEY_IDLE; }
+
+    /// @brief Get the channel chosen by the last survey or the one the module was on before
+    uint8_t channel() const { return mChannel; }
+
+    /// @brief Get the measurements of the last survey, one per candidate channel
+    const ChannelResult* results() const { return mResults; }
+
+    /// @brief Get the amount of candidate channels
+    size_t channelCount() const { return mChannelCount; }
+
+    /// @brief Get the amount of surveys so far
+    uint32_t surveys() const { return mSurveys; }
+
+    /// @brief Drive the survey and check the reply success of the chosen channel
+    /// @note Needs to be called inside loop(), the client needs its own update() calls too
+    void update();
+
+    void onStatus(const NETSGP::CompactStatus& status, const uint32_t timeMS) override;
+
+private:
+    /// @brief Steps of the survey
+    enum SurveyState
+    {
+        SURVEY_IDLE, /// Watching the reply success of the chosen channel
+        SURVEY_TUNING, /// Waiting for the RF module to be tuned to a candidate channel
+        SURVEY_DWELLING, /// Measuring a candidate channel
+        SURVEY_FINISHING, /// Waiting for the RF module to be tuned to the chosen channel
+    };
+
+    /// @brief Tune the RF module to a channel
+    bool tune(const uint8_t channel);
+
+    /// @brief Tune to the candidate channel at mIndex or to the best one after the last candidate
+    void next();
+
+    /// @brief Remember the current reply and timeout counters of the client
+    void takeBaseline();
+
+private:
+    AsyncNETSGPClientBase& mClient; /// Client whose RF module is tuned
+    bool mListening; /// Is the survey a status listener of the client
+    Tuning mTuning; /// Tuning of the survey
+    ChannelResult mResults[MAX_CHANNELS] = {}; /// Candidate channels and their measurements
+    size_t mChannelCount = 0; /// Amount of candidate channels
+    SurveyState mState = SURVEY_IDLE; /// Step of the survey
+    size_t mIndex = 0; /// Index of the candidate channel being measured
+    uint8_t mChannel = LC12S::DEFAULT_SETTINGS.rfChannel; /// Chosen channel
+    uint8_t mTuningChannel = 0; /// Channel the RF module is being tuned to
+    uint32_t mStepMS = 0; /// Start time of the current step or check interval
+    uint32_t mBaseReplies = 0; /// Replies of the client at the start of the current step
+    uint32_t mBaseTimeouts = 0; /// Timeouts of the client at the start of the current step
+    uint32_t mSurveys = 0; /// Surveys so far
+    uint16_t mExpectedPermille = 1000; /// Reply success the last survey measured on the chosen channel in permille
+    uint8_t mReached[32] = {}; /// Hashed set of inverters that replied on the current channel
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Fixed capacity registry of per device records kept sorted by device identifier.
+    ///
+    /// Records live in caller provided contiguous storage, so there is no heap allocation and lookups are a binary
+    /// search over a single array. Record must be trivially copyable and have a uint32_t deviceID member.
+    /// @tparam Record Per device record type
+    template <typename Record>
+    class DeviceRegistry
+    {
+    public:
+        /// @brief Construct a new DeviceRegistry object
+        ///
+        /// @param storage Storage for capacity records, must outlive the registry
+        /// @param capacity Maximum amount of records
+        DeviceRegistry(Record* storage, const size_t capacity) : mRecords(storage), mCapacity(capacity) { }
+
+        /// @brief Get the amount of registered devices
+        size_t size() const { return mSize; }
+
+        /// @brief Get the maximum amount of devices
+        size_t capacity() const { return mCapacity; }
+
+        /// @brief Check if no device is registered
+        bool empty() const { return mSize == 0; }
+
+        Record* begin() { return mRecords; }
+        Record* end() { return mRecords + mSize; }
+        const Record* begin() const { return mRecords; }
+        const Record* end() const { return mRecords + mSize; }
+
+        /// @brief Get the first record with a device identifier not less than the given one
+        ///
+        /// @param deviceID Device identifier to search for
+        /// @return Record* First matching record or nullptr if there is none
+        Record* lowerBound(const uint32_t deviceID)
+        {
+            const size_t index = lowerBoundIndex(deviceID);
+            return index < mSize ? &mRecords[index] : nullptr;
+        }
+
+        /// @brief Get the first record with a device identifier not less than the given one
+        ///
+        /// @param deviceID Device identifier to search for
+        /// @return const Record* First matching record or nullptr if there is none
+        const Record* lowerBound(const uint32_t deviceID) const
+        {
+            return const_cast<DeviceRegistry*>(this)->lowerBound(deviceID);
+        }
+
+        /// @brief Find the record of a device
+        ///
+        /// @param deviceID Device identifier to search for
+        /// @return Record* Record of the device or nullptr if not registered
+        Record* find(const uint32_t deviceID)
+        {
+            Record* record = lowerBound(deviceID);
+            return record && record->deviceID == deviceID ? record : nullptr;
+        }
+
+        /// @brief Find the record of a device
+        ///
+        /// @param deviceID Device identifier to search for
+        /// @return const Record* Record of the device or nullptr if not registered
+        const Record* find(const uint32_t deviceID) const { return const_cast<DeviceRegistry*>(this)->find(deviceID); }
+
+        /// @brief Insert a value initialized record for a device if not yet present
+        ///
+        /// Pointers to records behind the inserted one are invalidated.
+        /// @param deviceID Device identifier to insert
+        /// @return Record* Existing or new record, nullptr if the registry is full
+        Record* insert(const uint32_t deviceID)
+        {
+            const size_t index = lowerBoundIndex(deviceID);
+            if (index < mSize && mRecords[index].deviceID == deviceID)
+            {
+                return &mRecords[index];
+            }
+            if (mSize >= mCapacity)
+            {
+                return nullptr;
+            }
+            memmove(&mRecords[index + 1], &mRecords[index], (mSize - index) * sizeof(Record));
+            ++mSize;
+            mRecords[index] = Record();
+            mRecords[index].deviceID = deviceID;
+            return &mRecords[index];
+        }
+
+        /// @brief Remove the record of a device
+        ///
+        /// Pointers to records behind the removed one are invalidated.
+        /// @param deviceID Device identifier to remove
+        /// @return true If the device was removed
+        /// @return false If it was not registered
+        bool erase(const uint32_t deviceID)
+        {
+            const size_t index = lowerBoundIndex(deviceID);
+            if (index >= mSize || mRecords[index].deviceID != deviceID)
+            {
+                return false;
+            }
+            --mSize;
+            memmove(&mRecords[index], &mRecords[index + 1], (mSize - index) * sizeof(Record));
+            return true;
+        }
+
+    private:
+        size_t lowerBoundIndex(const uint32_t deviceID) const
+        {
+            size_t low = 0;
+            size_t high = mSize;
+            while (low < high)
+            {
+                const size_t mid = low + (high - low) / 2;
+                if (mRecords[mid].deviceID < deviceID)
+                {
+                    low = mid + 1;
+                }
+                else
+                {
+                    high = mid;
+                }
+            }
+            return low;
+        }
+
+    private:
+        Record* mRecords; /// Record storage
+        size_t mCapacity; /// Maximum amount of records
+        size_t mSize = 0; /// Amount of records in use
+    };
+} // namespace NETSGP
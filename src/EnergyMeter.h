@@ -0,0 +1,343 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "StatusListener.h"
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Energy totals in milliwatt hours
+    struct EnergyTotals
+    {
+        uint64_t dayMWh; /// Energy of the current day
+        uint64_t monthMWh; /// Energy of the current month
+        uint64_t previousDayMWh; /// Energy of the day before, see EnergyMeter::rollDay()
+        uint64_t previousMonthMWh; /// Energy of the month before, see EnergyMeter::rollMonth()
+        uint64_t totalMWh; /// Energy since the meter was started or restored
+    };
+
+    /// @brief Energy of one inverter and how it was measured
+    struct InverterEnergy
+    {
+        EnergyTotals totals; /// Energy totals
+        int64_t correctionMWh; /// Sum of all corrections from the counter, negative if integration read too much
+        uint32_t gapMWh; /// Energy taken from the counter to bridge gaps between statuses
+        uint16_t gaps; /// Gaps between statuses longer than EnergyMeter::Settings::maxGapMS
+        uint16_t counterResets; /// Times the counter went backwards, e.g. after a reboot
+        uint16_t rejected; /// Counter windows deviating too much from the integration, not used for correction
+    };
+
+    /// @brief Incremental energy accounting of inverters and the whole fleet in fixed point.
+    ///
+    /// Add it as status listener to an AsyncNETSGPClient. AC power is integrated with the trapezoidal rule over the
+    /// real time between two statuses, so neither samples nor floats are stored and the totals are exact to the
+    /// milliwatt hour of what was received. The integral misses energy between statuses and reads the AC power only in
+    /// centiamperes, so it is reconciled with the totalGeneratedPower counter of the inverter: whenever the counter
+    /// advanced by reconcileMWh the difference between counter and integral over that window is added to the totals,
+    /// unless it deviates more than maxDeviationPercent which hints at a garbled counter. Gaps longer than maxGapMS,
+    /// e.g. while the radio link was down, are bridged by the counter alone. A counter going backwards is taken as a
+    /// reboot of the inverter and starts a new window. There is no clock, call rollDay() at midnight and rollMonth()
+    /// at the start of a month, and save totals with energy() to restore() them after a reboot.
+    /// @note The unit of totalGeneratedPower is not reversed, kWh is assumed. Set Settings::counterMWh if it differs,
+    /// or to 0 to only integrate.
+    /// @tparam MaxInverters Maximum amount of inverters, statuses of further inverters are ignored
+    template <size_t MaxInverters>
+    class EnergyMeter : public StatusListener
+    {
+    public:
+        /// @brief Settings of the accounting
+        struct Settings
+        {
+            float counterMWh = 1000000.0f; /// Milliwatt hours per unit of totalGeneratedPower, 0 to ignore the counter
+            uint32_t maxGapMS = 300000; /// Longer gaps between statuses are bridged by the counter, not integrated
+            uint32_t reconcileMWh = 100000; /// Counter advance after which the integral is corrected
+            uint8_t maxDeviationPercent = 25; /// Larger differences between counter and integral are rejected
+            uint16_t maxPowerW = 2000; /// Upper bound of the power of a single inverter, limits bridged gaps
+        };
+
+    private:
+        constexpr static const uint64_t UNITS_PER_MWH = 72000000; /// Trapezoid units (1/10000 W * 2 * ms) per mWh
+
+        /// @brief Accounting state of a single inverter
+        struct Meter
+        {
+            uint32_t deviceID; /// Unique inverter identifier
+            bool used; /// Is this meter assigned to an inverter
+            bool started; /// Was a status received
+            uint32_t lastMS; /// Time of the last status
+            uint32_t lastPower; /// AC power of the last status in 1/10000 Watts
+            float lastCounter; /// Counter of the last status
+            float baseCounter; /// Counter at the start of the reconcile window
+            uint64_t windowMWh; /// Energy integrated since the start of the reconcile window
+            uint64_t residue; /// Trapezoid units not yet counted as a whole mWh
+            InverterEnergy energy; /// Totals and diagnostics
+        };
+
+    public:
+        /// @brief Change the settings, only affects statuses received afterwards
+        void setSettings(const Settings& settings) { mSettings = settings; }
+
+        /// @brief Account a status, called by AsyncNETSGPClient for every valid status
+        void onStatus(const CompactStatus& status, const uint32_t timeMS) override
+        {
+            Meter* meter = findMeter(status.deviceID, true);
+            if (!meter)
+            {
+                return;
+            }
+            const uint32_t power = status.acPowerRaw();
+            const float counter = status.totalGeneratedPower();
+            // NaN or infinite counters are garbage, they never take part in the reconciliation
+            const bool counterValid = mSettings.counterMWh > 0 && counter == counter && counter - counter == 0;
+            if (!meter->started)
+            {
+                meter->started = true;
+                restart(*meter, timeMS, power, counterValid ? counter : 0.0f);
+                return;
+            }
+
+            const uint32_t elapsedMS = timeMS - meter->lastMS;
+            if (counterValid && counter < meter->lastCounter)
+            {
+                // The inverter rebooted, what it produced since is in the new counter already
+                ++meter->energy.counterResets;
+                if (elapsedMS <= mSettings.maxGapMS)
+                {
+                    integrate(*meter, power, elapsedMS);
+                }
+                else
+                {
+                    bridge(*meter, counter, elapsedMS);
+                }
+                restart(*meter, timeMS, power, counter);
+                return;
+            }
+            if (elapsedMS > mSettings.maxGapMS)
+            {
+                ++meter->energy.gaps;
+                if (counterValid)
+                {
+                    bridge(*meter, counter - meter->lastCounter, elapsedMS);
+                }
+                restart(*meter, timeMS, power, counterValid ? counter : meter->lastCounter);
+                return;
+            }
+
+            integrate(*meter, power, elapsedMS);
+            meter->lastMS = timeMS;
+            meter->lastPower = power;
+            if (!counterValid)
+            {
+                return;
+            }
+            meter->lastCounter = counter;
+            const float counterMWh = (counter - meter->baseCounter) * mSettings.counterMWh;
+            if (counterMWh < mSettings.reconcileMWh)
+            {
+                return;
+            }
+            const int64_t deviation = static_cast<int64_t>(counterMWh) - static_cast<int64_t>(meter->windowMWh);
+            const uint64_t magnitude = deviation < 0 ? -deviation : deviation;
+            if (magnitude * 100 <= static_cast<uint64_t>(counterMWh) * mSettings.maxDeviationPercent)
+            {
+                correct(*meter, deviation);
+            }
+            else
+            {
+                ++meter->energy.rejected;
+            }
+            meter->baseCounter = counter;
+            meter->windowMWh = 0;
+        }
+
+        /// @brief Get the energy of an inverter
+        ///
+        /// @param deviceID The device identifier of the inverter
+        /// @param energy Energy to fill
+        /// @return true If the inverter has a meter
+        /// @return false If not
+        bool energy(const uint32_t deviceID, InverterEnergy& energy) const
+        {
+            const Meter* meter = const_cast<EnergyMeter*>(this)->findMeter(deviceID, false);
+            if (!meter)
+            {
+                return false;
+            }
+            energy = meter->energy;
+            return true;
+        }
+
+        /// @brief Get the energy of all inverters together
+        const EnergyTotals& fleet() const { return mFleet; }
+
+        /// @brief Restore saved totals of an inverter, e.g. after a reboot before its first status
+        ///
+        /// @param deviceID The device identifier of the inverter
+        /// @param totals Saved totals, also added to the fleet totals
+        /// @return true If the totals were restored
+        /// @return false If no meter is left
+        bool restore(const uint32_t deviceID, const EnergyTotals& totals)
+        {
+            Meter* meter = findMeter(deviceID, true);
+            if (!meter)
+            {
+                return false;
+            }
+            EnergyTotals& own = meter->energy.totals;
+            const uint64_t* from[] = {&totals.dayMWh, &totals.monthMWh, &totals.previousDayMWh,
+                &totals.previousMonthMWh, &totals.totalMWh};
+            uint64_t* to[] = {&own.dayMWh, &own.monthMWh, &own.previousDayMWh, &own.previousMonthMWh, &own.totalMWh};
+            uint64_t* fleet[] = {&mFleet.dayMWh, &mFleet.monthMWh, &mFleet.previousDayMWh, &mFleet.previousMonthMWh,
+                &mFleet.totalMWh};
+            for (size_t i = 0; i < 5; ++i)
+            {
+                *fleet[i] = *fleet[i] - *to[i] + *from[i];
+                *to[i] = *from[i];
+            }
+            return true;
+        }
+
+        /// @brief Close the current day of all inverters and the fleet, e.g. at midnight
+        void rollDay()
+        {
+            for (Meter& meter : mMeters)
+            {
+                meter.energy.totals.previousDayMWh = meter.energy.totals.dayMWh;
+                meter.energy.totals.dayMWh = 0;
+            }
+            mFleet.previousDayMWh = mFleet.dayMWh;
+            mFleet.dayMWh = 0;
+        }
+
+        /// @brief Close the current month of all inverters and the fleet, call rollDay() as well at a day change
+        void rollMonth()
+        {
+            for (Meter& meter : mMeters)
+            {
+                meter.energy.totals.previousMonthMWh = meter.energy.totals.monthMWh;
+                meter.energy.totals.monthMWh = 0;
+            }
+            mFleet.previousMonthMWh = mFleet.monthMWh;
+            mFleet.monthMWh = 0;
+        }
+
+        /// @brief Get the amount of inverters with a meter
+        size_t inverterCount() const
+        {
+            size_t count = 0;
+            for (const Meter& meter : mMeters)
+            {
+                count += meter.used;
+            }
+            return count;
+        }
+
+        /// @brief Remove all data
+        void clear()
+        {
+            memset(mMeters, 0, sizeof(mMeters));
+            mFleet = {};
+        }
+
+    private:
+        /// @brief Start a new integration and reconcile window at a status
+        void restart(Meter& meter, const uint32_t timeMS, const uint32_t power, const float counter)
+        {
+            meter.lastMS = timeMS;
+            meter.lastPower = power;
+            meter.lastCounter = counter;
+            meter.baseCounter = counter;
+            meter.windowMWh = 0;
+            meter.residue = 0;
+        }
+
+        /// @brief Integrate the AC power between the last and the current status
+        void integrate(Meter& meter, const uint32_t power, const uint32_t elapsedMS)
+        {
+            const uint64_t units = (static_cast<uint64_t>(meter.lastPower) + power) * elapsedMS + meter.residue;
+            const uint64_t mWh = units / UNITS_PER_MWH;
+            meter.residue = units % UNITS_PER_MWH;
+            meter.windowMWh += mWh;
+            add(meter, mWh);
+        }
+
+        /// @brief Account the counter advance over a gap, bounded by what the inverter could have produced
+        void bridge(Meter& meter, const float advance, const uint32_t elapsedMS)
+        {
+            if (!(advance > 0))
+            {
+                return;
+            }
+            const uint64_t limit = static_cast<uint64_t>(mSettings.maxPowerW) * elapsedMS / 3600;
+            const float counterMWh = advance * mSettings.counterMWh;
+            const uint64_t mWh = counterMWh < limit ? static_cast<uint64_t>(counterMWh) : limit;
+            meter.energy.gapMWh += mWh;
+            add(meter, mWh);
+        }
+
+        /// @brief Apply the difference between counter and integral to the totals
+        void correct(Meter& meter, const int64_t deviation)
+        {
+            meter.energy.correctionMWh += deviation;
+            if (deviation >= 0)
+            {
+                add(meter, deviation);
+                return;
+            }
+            uint64_t* totals[] = {&meter.energy.totals.dayMWh, &meter.energy.totals.monthMWh,
+                &meter.energy.totals.totalMWh, &mFleet.dayMWh, &mFleet.monthMWh, &mFleet.totalMWh};
+            for (uint64_t* total : totals)
+            {
+                *total = *total > static_cast<uint64_t>(-deviation) ? *total + deviation : 0;
+            }
+        }
+
+        /// @brief Add energy to the totals of an inverter and the fleet
+        void add(Meter& meter, const uint64_t mWh)
+        {
+            meter.energy.totals.dayMWh += mWh;
+            meter.energy.totals.monthMWh += mWh;
+            meter.energy.totals.totalMWh += mWh;
+            mFleet.dayMWh += mWh;
+            mFleet.monthMWh += mWh;
+            mFleet.totalMWh += mWh;
+        }
+
+        /// @brief Find the meter of an inverter
+        ///
+        /// @param deviceID The device identifier of the inverter
+        /// @param create Assign a free meter if none is found
+        /// @return Meter* Found meter or nullptr
+        Meter* findMeter(const uint32_t deviceID, const bool create)
+        {
+            Meter* free = nullptr;
+            for (Meter& meter : mMeters)
+            {
+                if (meter.used && meter.deviceID == deviceID)
+                {
+                    return &meter;
+                }
+                if (!meter.used && !free)
+                {
+                    free = &meter;
+                }
+            }
+            if (!create || !free)
+            {
+                return nullptr;
+            }
+            memset(free, 0, sizeof(Meter));
+            free->deviceID = deviceID;
+            free->used = true;
+            return free;
+        }
+
+    private:
+        Settings mSettings; /// Settings of the accounting
+        Meter mMeters[MaxInverters] = {}; /// One meter per inverter
+        EnergyTotals mFleet = {}; /// Totals of all inverters
+    };
+} // namespace NETSGP
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "ByteRing.h"
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Portable interface to the UART of the RF module for event driven reception
+    class RxBackend
+    {
+    public:
+        virtual ~RxBackend() { }
+
+        /// @brief Write bytes to the RF module
+        ///
+        /// @return size_t Amount of written bytes
+        virtual size_t write(const uint8_t* data, const size_t length) = 0;
+
+        /// @brief Move received bytes into the ring, waiting up to timeoutMS if there are none yet.
+        ///
+        /// Backends fed by an interrupt or receive event push into the ring from there and only need to wait.
+        /// @param ring Ring to push received bytes into
+        /// @param timeoutMS Maximum time to wait in milliseconds, 0 to never wait
+        /// @return true If the ring contains bytes
+        /// @return false If not
+        virtual bool receive(ByteRingBase& ring, const uint32_t timeoutMS) = 0;
+    };
+
+    /// @brief Backend for any Arduino Stream.
+    ///
+    /// By default receive() polls the Stream with pump(). To move bytes into the ring as they arrive, call
+    /// setEventDriven(true) and pump() from the receive event of the UART, e.g. serialEvent() or
+    /// HardwareSerial::onReceive() on ESP32. The receive event is then the only producer of the ring and the only
+    /// reader of the Stream, receive() just waits for it.
+    class StreamRxBackend : public RxBackend
+    {
+    public:
+        /// @brief Construct a new StreamRxBackend object.
+        ///
+        /// @param stream Stream connected to the RF module
+        explicit StreamRxBackend(Stream& stream) : mStream(stream) { }
+
+        /// @brief Select who calls pump(), only while no client is using the backend
+        ///
+        /// @param eventDriven True if the receive event calls pump(), false if receive() polls the Stream
+        void setEventDriven(const bool eventDriven) { mEventDriven = eventDriven; }
+
+        /// @brief Move all received bytes into the ring, the only call allowed from the receive event
+        ///
+        /// @param ring Ring to push received bytes into
+        /// @return size_t Amount of moved bytes
+        size_t pump(ByteRingBase& ring)
+        {
+            size_t count = 0;
+            while (mStream.available() > 0 && ring.size() < ring.capacity())
+            {
+                ring.push(static_cast<uint8_t>(mStream.read()));
+                ++count;
+            }
+            return count;
+        }
+
+        size_t write(const uint8_t* data, const size_t length) override { return mStream.write(data, length); }
+
+        bool receive(ByteRingBase& ring, const uint32_t timeoutMS) override
+        {
+            const uint32_t startTime = millis();
+            while ((mEventDriven || !pump(ring)) && ring.empty())
+            {
+                if (millis() - startTime >= timeoutMS)
+                {
+                    return false;
+                }
+                delay(1);
+            }
+            return true;
+        }
+
+    private:
+        Stream& mStream; /// Stream connected to the RF module
+        bool mEventDriven = false; /// Does the receive event call pump() instead of receive()
+    };
+
+    /// @brief Stream reading from a lock-free ring filled by an RxBackend and writing through the backend.
+    ///
+    /// Pass it to NETSGPClient or AsyncNETSGPClient instead of the UART. The client then only consumes bytes that
+    /// already arrived, so AsyncNETSGPClient::update() does not need to be spun but can be called after
+    /// waitForData() returned, e.g. with AsyncNETSGPClientBase::nextActionMS() as timeout.
+    class EventStream : public Stream
+    {
+    public:
+        /// @brief Construct a new EventStream object.
+        ///
+        /// @param backend Backend connected to the RF module
+        /// @param ring Ring for received bytes, the backend or its receive event is the only producer
+        EventStream(RxBackend& backend, ByteRingBase& ring) : mBackend(backend), mRing(ring) { }
+
+        /// @brief Wait until received bytes are available
+        ///
+        /// @param timeoutMS Maximum time to wait in milliseconds, 0 to only check
+        /// @return true If received bytes are available
+        /// @return false If the timeout elapsed
+        bool waitForData(const uint32_t timeoutMS) { return !mRing.empty() || mBackend.receive(mRing, timeoutMS); }
+
+        /// @brief Get the ring, e.g. to push into it from an interrupt
+        ByteRingBase& ring() { return mRing; }
+
+        int available() override { return waitForData(0) ? static_cast<int>(mRing.size()) : 0; }
+        int read() override { return mRing.empty() && !waitForData(0) ? -1 : mRing.pop(); }
+        int peek() override { return mRing.empty() && !waitForData(0) ? -1 : mRing.peek(); }
+        size_t write(uint8_t byte) override { return mBackend.write(&byte, 1); }
+        size_t write(const uint8_t* buffer, size_t size) override { return mBackend.write(buffer, size); }
+        using Print::write;
+
+    private:
+        RxBackend& mBackend; /// Backend connected to the RF module
+        ByteRingBase& mRing; /// Received bytes
+    };
+} // namespace NETSGP
@@ -0,0 +1,188 @@
+#include "ExportController.h"
+
+#include <Arduino.h>
+
+ExportControllerBase::ExportControllerBase(AsyncNETSGPClientBase& client, InverterRecord* records,
+    AsyncNETSGPClientBase::BatchEntry* entries, const size_t capacity)
+    : mClient(client), mInverters(records, capacity), mEntries(entries)
+{ }
+
+bool ExportControllerBase::addInverter(const uint32_t deviceID, const uint16_t ratedW)
+{
+    InverterRecord* record = mInverters.insert(deviceID);
+    if (!record)
+    {
+        return false;
+    }
+    record->ratedW = ratedW;
+    return true;
+}
+
+bool ExportControllerBase::update(const int32_t gridPowerW)
+{
+    if (mBatchActive)
+    {
+        if (mClient.batchRunning())
+        {
+            return false;
+        }
+        collectBatch();
+    }
+
+    const uint32_t currentMillis = millis();
+    if (mInverters.empty() || currentMillis - mLastStepMS < mSettings.minIntervalMS)
+    {
+        return false;
+    }
+
+    bool gradesKnown = true;
+    for (const InverterRecord& record : mInverters)
+    {
+        gradesKnown &= record.gradeKnown;
+    }
+    const int32_t error = gridPowerW - mSettings.targetW;
+    if (gradesKnown && (error < 0 ? -error : error) <= mSettings.deadbandW)
+    {
+        return false;
+    }
+
+    // The load stays the same, so the fleet has to deliver what it delivers now plus the missing grid power
+    const int32_t demandW = static_cast<int32_t>(productionW()) + error;
+    const uint8_t powerGrade = findPowerGrade(demandW > 0 ? demandW : 0);
+
+    size_t count = 0;
+    for (const InverterRecord& record : mInverters)
+    {
+        if (record.gradeKnown)
+        {
+            const uint8_t step = powerGrade > record.powerGrade ? powerGrade - record.powerGrade
+                                                                : record.powerGrade - powerGrade;
+            const bool bound = powerGrade == 100 || powerGrade == mSettings.minPowerGrade;
+            if (!step || (step < mSettings.minStepPG && !bound))
+            {
+                continue;
+            }
+            if (expectedW(record, powerGrade) == expectedW(record, record.powerGrade))
+            {
+                // Not enough sun to reach either limit, the command would not change anything
+                continue;
+            }
+        }
+        mEntries[count] = {};
+        mEntries[count].deviceID = record.deviceID;
+        mEntries[count].value = powerGrade;
+        ++count;
+    }
+
+    if (!count || !mClient.startPowerGradeBatch(mEntries, count))
+    {
+        return false;
+    }
+    DEBUGF("[ExportController] Grid %dW, setting %u inverters to PG%u\n", gridPowerW, static_cast<unsigned>(count),
+        powerGrade);
+    mBatchActive = true;
+    mEntryCount = count;
+    mLastStepMS = currentMillis;
+    ++mStatistics.steps;
+    mStatistics.commands += count;
+    return true;
+}
+
+int ExportControllerBase::powerGrade(const uint32_t deviceID) const
+{
+    const InverterRecord* record = mInverters.find(deviceID);
+    return record && record->gradeKnown ? record->powerGrade : -1;
+}
+
+uint32_t ExportControllerBase::productionW() const
+{
+    uint32_t sum = 0;
+    for (const InverterRecord& record : mInverters)
+    {
+        sum += record.acPowerW;
+    }
+    return sum;
+}
+
+void ExportControllerBase::onStatus(const NETSGP::CompactStatus& status, const uint32_t)
+{
+    InverterRecord* record = mInverters.find(status.deviceID);
+    if (record)
+    {
+        const uint32_t acPowerW = status.acPowerRaw() / 10000;
+        record->acPowerW = acPowerW > 0xFFFF ? 0xFFFF : acPowerW;
+    }
+}
+
+void ExportControllerBase::collectBatch()
+{
+    mBatchActive = false;
+    for (size_t i = 0; i < mEntryCount; ++i)
+    {
+        const AsyncNETSGPClientBase::BatchEntry& entry = mEntries[i];
+        InverterRecord* record = mInverters.find(entry.deviceID);
+        if (!record)
+        {
+            continue;
+        }
+        if (!entry.done || entry.outcome != AsyncNETSGPClientBase::COMMAND_SUCCESS)
+        {
+            // The inverter may or may not have applied it, command it again on the next step
+            ++mStatistics.failures;
+            record->gradeKnown = false;
+            continue;
+        }
+        // A lowered limit applies right away, do not count on power the inverter no longer delivers
+        const uint32_t limitW = static_cast<uint32_t>(record->ratedW) * entry.value / 100;
+        if (record->acPowerW > limitW)
+        {
+            record->acPowerW = limitW;
+        }
+        record->powerGrade = entry.value;
+        record->gradeKnown = true;
+    }
+    mEntryCount = 0;
+}
+
+uint32_t ExportControllerBase::capacityW(const InverterRecord& record) const
+{
+    const uint32_t limitW = static_cast<uint32_t>(record.ratedW) * record.powerGrade / 100;
+    const uint32_t marginW = record.ratedW / 50 + 5;
+    if (record.gradeKnown && record.acPowerW + marginW < limitW)
+    {
+        return record.acPowerW;
+    }
+    return record.ratedW;
+}
+
+uint32_t ExportControllerBase::expectedW(const InverterRecord& record, const uint8_t powerGrade) const
+{
+    const uint32_t capacity = capacityW(record);
+    const uint32_t limitW = static_cast<uint32_t>(record.ratedW) * powerGrade / 100;
+    return limitW < capacity ? limitW : capacity;
+}
+
+uint8_t ExportControllerBase::findPowerGrade(const uint32_t demandW) const
+{
+    // The expected production only grows with the power grade, search the largest one not above the demand
+    uint8_t low = mSettings.minPowerGrade;
+    uint8_t high = 100;
+    while (low < high)
+    {
+        const uint8_t mid = (low + high + 1) / 2;
+        uint32_t production = 0;
+        for (const InverterRecord& record : mInverters)
+        {
+            production += expectedW(record, mid);
+        }
+        if (production <= demandW)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "AsyncNETSGPClient.h"
+#include "DeviceRegistry.h"
+#include "StatusListener.h"
+
+/// @brief Closed loop feed-in limiter, see BasicExportController and ExportController for instantiable variants
+///
+/// Add it as status listener to an AsyncNETSGPClient and call update() with every grid meter reading. The controller
+/// estimates the power the fleet could deliver from the live AC power and the rated power of every inverter and
+/// computes one common power grade that brings the grid power to the target. Inverters already producing less than
+/// their limit (not enough sun) are accounted with their actual power, so the headroom of the others is used first.
+/// All setpoints of one step go out as a single batch and only inverters whose output would actually change get a
+/// command, so the controller converges in as few RF round trips as possible. A new step is only taken after the
+/// previous batch completed and at most every minIntervalMS.
+class ExportControllerBase : public NETSGP::StatusListener
+{
+public:
+    /// @brief Tuning of the controller
+    struct Settings
+    {
+        int32_t targetW = 0; /// Target grid power in Watts, positive is import, 0 means zero export
+        uint16_t deadbandW = 25; /// Do nothing while the grid power is within this distance to the target
+        uint8_t minStepPG = 2; /// Minimum power grade change worth a command
+        uint8_t minPowerGrade = 0; /// Never set a power grade below this one
+        uint16_t minIntervalMS = 1000; /// Minimum time between two steps in milliseconds
+    };
+
+    /// @brief Counters of the controller
+    struct ControllerStatistics
+    {
+        uint32_t steps; /// Steps that sent new setpoints
+        uint32_t commands; /// Power grade commands sent
+        uint32_t failures; /// Power grade commands that failed after all retries
+    };
+
+protected:
+    /// @brief Per inverter record stored in the device registry
+    struct InverterRecord
+    {
+        uint32_t deviceID; /// Unique inverter identifier
+        uint16_t ratedW = 0; /// Rated AC power in Watts
+        uint16_t acPowerW = 0; /// Last known AC power in Watts
+        uint8_t powerGrade = 100; /// Last confirmed power grade, valid if gradeKnown is true
+        bool gradeKnown = false; /// Was the power grade confirmed by the inverter
+    };
+
+    /// @brief Construct a new ExportControllerBase object.
+    ///
+    /// @param client Client to send commands with
+    /// @param records Storage for the device registry, only its address is used during construction
+    /// @param entries Storage for the command batch, must hold capacity entries
+    /// @param capacity Maximum amount of inverters in records and entries
+    ExportControllerBase(AsyncNETSGPClientBase& client, InverterRecord* records,
+        AsyncNETSGPClientBase::BatchEntry* entries, const size_t capacity);
+
+public:
+    ExportControllerBase(const ExportControllerBase&) = delete;
+    ExportControllerBase& operator=(const ExportControllerBase&) = delete;
+
+    /// @brief Control an inverter, it must also be registered at the client to receive its status
+    ///
+    /// @param deviceID The device identifier of the inverter
+    /// @param ratedW Rated AC power of the inverter in Watts
+    /// @return true If the inverter is controlled
+    /// @return false If the maximum amount of inverters is reached
+    bool addInverter(const uint32_t deviceID, const uint16_t ratedW);
+
+    /// @brief Stop controlling an inverter, its power grade is left as it is
+    ///
+    /// @param deviceID The device identifier of the inverter
+    void removeInverter(const uint32_t deviceID) { mInverters.erase(deviceID); }
+
+    /// @brief Change the tuning of the controller
+    void setSettings(const Settings& settings) { mSettings = settings; }
+
+    /// @brief Change the target grid power in Watts, positive is import
+    void setTarget(const int32_t targetW) { mSettings.targetW = targetW; }
+
+    /// @brief Feed a grid meter reading and send new setpoints if needed
+    ///
+    /// @param gridPowerW Measured grid power in Watts, positive is import, negative is export
+    /// @return true If new setpoints are being sent
+    /// @return false If no step was needed or possible
+    bool update(const int32_t gridPowerW);
+
+    /// @brief Get the last confirmed power grade of an inverter
+    ///
+    /// @param deviceID The device identifier of the inverter
+    /// @return int Power grade or -1 if unknown
+    int powerGrade(const uint32_t deviceID) const;
+
+    /// @brief Get the estimated AC power of all controlled inverters in Watts
+    uint32_t productionW() const;
+
+    /// @brief Get the counters of the controller
+    const ControllerStatistics& statistics() const { return mStatistics; }
+
+    /// @brief Track the AC power of controlled inverters, called by AsyncNETSGPClient for every valid status
+    void onStatus(const NETSGP::CompactStatus& status, const uint32_t timeMS) override;
+
+private:
+    /// @brief Take over the outcome of the completed batch
+    void collectBatch();
+
+    /// @brief Power an inverter could deliver at most, its actual power if sun limited or else its rated power
+    uint32_t capacityW(const InverterRecord& record) const;
+
+    /// @brief Power an inverter is expected to deliver at a power grade
+    uint32_t expectedW(const InverterRecord& record, const uint8_t powerGrade) const;
+
+    /// @brief Power grade that brings the production of all inverters closest to but not above demandW
+    uint8_t findPowerGrade(const uint32_t demandW) const;
+
+private:
+    AsyncNETSGPClientBase& mClient; /// Client to send commands with
+    NETSGP::DeviceRegistry<InverterRecord> mInverters; /// All controlled inverters
+    AsyncNETSGPClientBase::BatchEntry* mEntries; /// Batch storage
+    size_t mEntryCount = 0; /// Amount of entries of the running batch
+    bool mBatchActive = false; /// Is a batch of this controller running
+    uint32_t mLastStepMS = 0; /// Start time of the last step
+    Settings mSettings; /// Tuning
+    ControllerStatistics mStatistics = {}; /// Counters
+};
+
+/// @brief Feed-in limiter with storage for a fixed maximum amount of inverters
+///
+/// @tparam MaxInverters Maximum amount of inverters that can be controlled
+template <size_t MaxInverters>
+class BasicExportController : public ExportControllerBase
+{
+public:
+    /// @brief Construct a new BasicExportController object.
+    ///
+    /// @param client Client to send commands with
+    explicit BasicExportController(AsyncNETSGPClientBase& client)
+        : ExportControllerBase(client, &mRecords[0], &mEntries[0], MaxInverters)
+    { }
+
+private:
+    InverterRecord mRecords[MaxInverters]; /// Storage of the device registry
+    AsyncNETSGPClientBase::BatchEntry mEntries[MaxInverters]; /// Storage of the command batch
+};
+
+/// @brief Feed-in limiter for up to 16 inverters
+typedef BasicExportController<16> ExportController;
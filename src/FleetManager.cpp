@@ -0,0 +1,317 @@
+#include "FleetManager.h"
+
+#include <Arduino.h>
+
+FleetManagerBase::~FleetManagerBase()
+{
+    for (uint8_t i = 0; i < mRadioCount; ++i)
+    {
+        mRadios[i]->removeStatusListener(mRadioListeners[i]);
+    }
+}
+
+bool FleetManagerBase::addRadio(AsyncNETSGPClientBase& client)
+{
+    if (mRadioCount >= MAX_RADIOS)
+    {
+        return false;
+    }
+    RadioListener& listener = mRadioListeners[mRadioCount];
+    listener.manager = this;
+    listener.radio = mRadioCount;
+    if (!client.addStatusListener(listener))
+    {
+        return false;
+    }
+    mRadios[mRadioCount++] = &client;
+    return true;
+}
+
+bool FleetManagerBase::addInverter(const uint32_t deviceID)
+{
+    if (mRadioCount == 0)
+    {
+        return false;
+    }
+    InverterRecord* record = mInverters.insert(deviceID);
+    if (!record)
+    {
+        return false;
+    }
+    if (record->radio != NO_RADIO)
+    {
+        return true;
+    }
+
+    uint8_t best = NO_RADIO;
+    for (uint8_t i = 0; i < mRadioCount; ++i)
+    {
+        const size_t load = radioLoad(i);
+        if (load < mRadios[i]->maxInverters() && (best == NO_RADIO || load < radioLoad(best)))
+        {
+            best = i;
+        }
+    }
+    if (best == NO_RADIO || !assign(*record, best))
+    {
+        mInverters.erase(deviceID);
+        return false;
+    }
+    return true;
+}
+
+void FleetManagerBase::removeInverter(const uint32_t deviceID)
+{
+    const InverterRecord* record = mInverters.find(deviceID);
+    if (record)
+    {
+        if (record->radio != NO_RADIO)
+        {
+            mRadios[record->radio]->deregisterInverter(deviceID);
+        }
+        mInverters.erase(deviceID);
+    }
+}
+
+bool FleetManagerBase::addStatusListener(NETSGP::StatusListener& listener)
+{
+    NETSGP::StatusListener** freeSlot = nullptr;
+    for (NETSGP::StatusListener*& slot : mListeners)
+    {
+        if (slot == &listener)
+        {
+            return true;
+        }
+        if (!slot && !freeSlot)
+        {
+            freeSlot = &slot;
+        }
+    }
+    if (!freeSlot)
+    {
+        return false;
+    }
+    *freeSlot = &listener;
+    return true;
+}
+
+void FleetManagerBase::removeStatusListener(NETSGP::StatusListener& listener)
+{
+    for (NETSGP::StatusListener*& slot : mListeners)
+    {
+        if (slot == &listener)
+        {
+            slot = nullptr;
+        }
+    }
+}
+
+uint8_t FleetManagerBase::radioOf(const uint32_t deviceID) const
+{
+    const InverterRecord* record = mInverters.find(deviceID);
+    return record ? record->radio : NO_RADIO;
+}
+
+size_t FleetManagerBase::radioLoad(const uint8_t index) const
+{
+    return index < mRadioCount ? mRadios[index]->inverterCount() : 0;
+}
+
+void FleetManagerBase::update()
+{
+    for (uint8_t i = 0; i < mRadioCount; ++i)
+    {
+        mRadios[i]->update();
+    }
+
+    const uint32_t currentMillis = millis();
+    if (currentMillis - mLastEvaluationMS >= mTuning.evaluateIntervalMS)
+    {
+        mLastEvaluationMS = currentMillis;
+        evaluate();
+        // Every move evens out the load by two, so this ends after at most half the inverters
+        for (size_t i = 0; i < mInverters.size() && balance(); ++i)
+        { }
+    }
+}
+
+void FleetManagerBase::evaluate()
+{
+    const uint16_t degraded = static_cast<uint16_t>(mTuning.degradedPercent) * 255 / 100;
+    const uint16_t hysteresis = static_cast<uint16_t>(mTuning.hysteresisPercent) * 255 / 100;
+
+    for (InverterRecord& record : mInverters)
+    {
+        // Links that are not used any more slowly regain trust, so a recovered radio is tried again eventually
+        for (uint8_t i = 0; i < mRadioCount; ++i)
+        {
+            if (i != record.radio)
+            {
+                record.quality[i] += (255 - record.quality[i]) / 8;
+            }
+        }
+
+        AsyncNETSGPClientBase::InverterInfo info;
+        if (!mRadios[record.radio]->getInverterInfo(record.deviceID, info))
+        {
+            continue;
+        }
+        const uint32_t replies = info.replies - record.baseReplies;
+        const uint32_t attempts = replies + info.timeouts - record.baseTimeouts;
+        // Inverters in backoff are polled less often, their timeouts in a row already rate the link
+        if (attempts == 0 || (attempts < mTuning.minAttempts && info.health == AsyncNETSGPClientBase::HEALTH_ONLINE))
+        {
+            continue;
+        }
+        record.baseReplies = info.replies;
+        record.baseTimeouts = info.timeouts;
+
+        uint32_t sample = replies * 255 / attempts;
+        // Slow replies hold in-flight slots of the radio, links far above the median latency count as partly failed
+        if (info.rttMS)
+        {
+            trackMedianRtt(info.rttMS);
+            const uint32_t slowMS = static_cast<uint32_t>(mMedianRttMS) * mTuning.slowPercent / 100;
+            if (slowMS && info.rttMS > slowMS)
+            {
+                sample = sample * slowMS / info.rttMS;
+            }
+        }
+        const uint8_t bit = 1 << record.radio;
+        uint8_t& quality = record.quality[record.radio];
+        quality = static_cast<uint8_t>((record.rated & bit) ? (3 * quality + sample) / 4 : sample);
+        record.rated |= bit;
+        if (quality >= degraded)
+        {
+            continue;
+        }
+
+        uint8_t best = NO_RADIO;
+        for (uint8_t i = 0; i < mRadioCount; ++i)
+        {
+            if (i != record.radio && radioLoad(i) < mRadios[i]->maxInverters()
+                && (best == NO_RADIO || expectedQuality(record, i) > expectedQuality(record, best)
+                    || (expectedQuality(record, i) == expectedQuality(record, best) && radioLoad(i) < radioLoad(best))))
+            {
+                best = i;
+            }
+        }
+        if (best != NO_RADIO && expectedQuality(record, best) >= quality + hysteresis)
+        {
+            move(record, best);
+        }
+    }
+}
+
+bool FleetManagerBase::balance()
+{
+    uint8_t most = 0;
+    uint8_t least = 0;
+    for (uint8_t i = 1; i < mRadioCount; ++i)
+    {
+        most = radioLoad(i) > radioLoad(most) ? i : most;
+        least = radioLoad(i) < radioLoad(least) ? i : least;
+    }
+    if (radioLoad(most) < radioLoad(least) + 2 || radioLoad(least) >= mRadios[least]->maxInverters())
+    {
+        return false;
+    }
+
+    // Only take inverters that are expected to be reached about as well by the less loaded radio
+    const uint16_t hysteresis = static_cast<uint16_t>(mTuning.hysteresisPercent) * 255 / 100;
+    InverterRecord* candidate = nullptr;
+    for (InverterRecord& record : mInverters)
+    {
+        if (record.radio == most && expectedQuality(record, least) + hysteresis >= expectedQuality(record, most)
+            && (!candidate || expectedQuality(record, least) > expectedQuality(*candidate, least)))
+        {
+            candidate = &record;
+        }
+    }
+    return candidate && move(*candidate, least);
+}
+
+void FleetManagerBase::RadioListener::onStatus(const NETSGP::CompactStatus& status, const uint32_t timeMS)
+{
+    manager->forwardStatus(radio, status, timeMS);
+}
+
+void FleetManagerBase::forwardStatus(const uint8_t radio, const NETSGP::CompactStatus& status, const uint32_t timeMS)
+{
+    const uint8_t assigned = radioOf(status.deviceID);
+    if (assigned == NO_RADIO)
+    {
+        // Radios on the same channel overhear each other, the first copy of a reply to a probe wins
+        if (status.deviceID == mForeignID && timeMS - mForeignMS < 1000)
+        {
+            return;
+        }
+        mForeignID = status.deviceID;
+        mForeignMS = timeMS;
+    }
+    else if (assigned != radio)
+    {
+        return;
+    }
+    for (NETSGP::StatusListener* listener : mListeners)
+    {
+        if (listener)
+        {
+            listener->onStatus(status, timeMS);
+        }
+    }
+}
+
+void FleetManagerBase::trackMedianRtt(const uint16_t rttMS)
+{
+    // Frugal streaming median, every sample moves the estimate by a small step towards it
+    if (!mMedianRttMS)
+    {
+        mMedianRttMS = rttMS;
+        return;
+    }
+    const uint16_t step = mMedianRttMS / 16 + 1;
+    if (rttMS > mMedianRttMS)
+    {
+        mMedianRttMS += rttMS - mMedianRttMS < step ? rttMS - mMedianRttMS : step;
+    }
+    else if (rttMS < mMedianRttMS)
+    {
+        mMedianRttMS -= mMedianRttMS - rttMS < step ? mMedianRttMS - rttMS : step;
+    }
+}
+
+uint8_t FleetManagerBase::expectedQuality(const InverterRecord& record, const uint8_t radio)
+{
+    return (record.rated & (1 << radio)) ? record.quality[radio] : 255;
+}
+
+bool FleetManagerBase::move(InverterRecord& record, const uint8_t radio)
+{
+    // Register at the new radio first, so the inverter stays polled by the old one if that fails
+    const uint8_t previous = record.radio;
+    if (!assign(record, radio))
+    {
+        DEBUGF("[FleetManager] Moving %#08x to radio %u failed\n", record.deviceID, radio);
+        ++mFailedMoves;
+        return false;
+    }
+    mRadios[previous]->deregisterInverter(record.deviceID);
+    ++mMoves;
+    return true;
+}
+
+bool FleetManagerBase::assign(InverterRecord& record, const uint8_t radio)
+{
+    AsyncNETSGPClientBase& client = *mRadios[radio];
+    if (!client.registerInverter(record.deviceID))
+    {
+        return false;
+    }
+    AsyncNETSGPClientBase::InverterInfo info;
+    client.getInverterInfo(record.deviceID, info);
+    record.radio = radio;
+    record.baseReplies = info.replies;
+    record.baseTimeouts = info.timeouts;
+    return true;
+}
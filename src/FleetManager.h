@@ -0,0 +1,191 @@
+#pragma once
+
+#include "AsyncNETSGPClient.h"
+#include "DeviceRegistry.h"
+#include "StatusListener.h"
+
+/// @brief Shards inverters across several RF modules, see BasicFleetManager and FleetManager for instantiable variants
+///
+/// Every radio is an AsyncNETSGPClient with its own Stream, programming pin and module settings, e.g. on another RF
+/// channel or placed elsewhere. The manager registers every inverter at exactly one radio, so the radios poll in
+/// parallel and the aggregate poll rate grows with the amount of radios. New inverters go to the radio with the fewest
+/// inverters. The reply success of every inverter is measured on its radio and an inverter whose link degrades is
+/// moved to the radio with the best known (or not yet measured) link to it. A link whose smoothed reply latency is
+/// well above the median of the fleet counts as degraded in proportion, since slow replies hold in-flight slots and
+/// delay every other request of the radio. Load differences are evened out by moving inverters to radios that are
+/// expected to reach them about as well. Status listeners get every status once, from the radio the inverter is
+/// assigned to, even if other radios overhear it.
+/// @note Do not register inverters at the radios yourself, use addInverter()
+class FleetManagerBase
+{
+public:
+    /// @brief Tuning of the assignment
+    struct Tuning
+    {
+        uint32_t evaluateIntervalMS = 30000; /// Time between two evaluations of all links in milliseconds
+        uint8_t minAttempts = 5; /// Minimum amount of requests on a link before it is rated
+        uint8_t degradedPercent = 80; /// Move inverters whose reply success falls below this
+        uint8_t hysteresisPercent = 10; /// Only move if another radio is expected to be this much better
+        uint16_t slowPercent = 300; /// Scale down reply success of links slower than this share of the median latency
+    };
+
+    constexpr static const size_t MAX_RADIOS = 4; /// Maximum amount of radios
+    constexpr static const uint8_t NO_RADIO = 0xFF; /// Radio index of unassigned inverters
+
+protected:
+    /// @brief Per inverter record stored in the device registry
+    struct InverterRecord
+    {
+        uint32_t deviceID; /// Unique inverter identifier
+        uint8_t radio = NO_RADIO; /// Index of the assigned radio
+        uint8_t quality[MAX_RADIOS] = {}; /// Latency weighted reply success per radio, 0 - 255, valid if rated
+        uint8_t rated = 0; /// Bit mask of radios with a rated link to this inverter
+        uint32_t baseReplies = 0; /// Replies on the assigned radio at the last evaluation
+        uint32_t baseTimeouts = 0; /// Timeouts on the assigned radio at the last evaluation
+    };
+
+    /// @brief Construct a new FleetManagerBase object.
+    ///
+    /// @param records Storage for the device registry, only its address is used during construction
+    /// @param capacity Maximum amount of inverters in records
+    FleetManagerBase(InverterRecord* records, const size_t capacity) : mInverters(records, capacity) { }
+
+public:
+    /// @brief Remove the manager from the status listeners of all radios
+    ~FleetManagerBase();
+
+    FleetManagerBase(const FleetManagerBase&) = delete;
+    FleetManagerBase& operator=(const FleetManagerBase&) = delete;
+
+    /// @brief Add a radio, only before adding inverters
+    ///
+    /// @param client Client of the radio, must outlive this manager
+    /// @return true If the radio was added
+    /// @return false If MAX_RADIOS are already present
+    bool addRadio(AsyncNETSGPClientBase& client);
+
+    /// @brief Change the tuning of the assignment
+    void setTuning(const Tuning& tuning) { mTuning = tuning; }
+
+    /// @brief Add an inverter and register it at the radio with the fewest inverters
+    ///
+    /// @param deviceID The device identifier of the inverter
+    /// @return true If the inverter was added
+    /// @return false If no radio is present, the maximum amount of inverters is reached or the radio is full
+    bool addInverter(const uint32_t deviceID);
+
+    /// @brief Remove an inverter from the fleet and its radio
+    ///
+    /// @param deviceID The device identifier of the inverter
+    void removeInverter(const uint32_t deviceID);
+
+    /// @brief Add a status listener that gets every status once, from the radio the inverter is assigned to
+    ///
+    /// Statuses of inverters not in the fleet are forwarded from the first radio receiving them within a second.
+    /// @param listener Listener to add, must outlive this manager or be removed before
+    /// @return true If the listener was added or was already present
+    /// @return false If MAX_STATUS_LISTENERS are already present
+    bool addStatusListener(NETSGP::StatusListener& listener);
+
+    /// @brief Remove a status listener
+    ///
+    /// @param listener Listener to remove
+    void removeStatusListener(NETSGP::StatusListener& listener);
+
+    /// @brief Get the radio an inverter is assigned to
+    ///
+    /// @param deviceID The device identifier of the inverter
+    /// @return uint8_t Index of the radio or NO_RADIO
+    uint8_t radioOf(const uint32_t deviceID) const;
+
+    /// @brief Get the client of a radio
+    AsyncNETSGPClientBase& radio(const uint8_t index) { return *mRadios[index]; }
+
+    /// @brief Get the amount of radios
+    size_t radioCount() const { return mRadioCount; }
+
+    /// @brief Get the amount of inverters assigned to a radio
+    size_t radioLoad(const uint8_t index) const;
+
+    /// @brief Get the amount of moves between radios so far
+    uint32_t moves() const { return mMoves; }
+
+    /// @brief Get the amount of moves that failed because the target radio did not accept the inverter
+    uint32_t failedMoves() const { return mFailedMoves; }
+
+    /// @brief Update all radios and evaluate the links every evaluateIntervalMS
+    /// @note Needs to be called inside loop()
+    void update();
+
+private:
+    /// @brief Listener of a single radio forwarding the statuses to the listeners of the manager
+    class RadioListener : public NETSGP::StatusListener
+    {
+    public:
+        void onStatus(const NETSGP::CompactStatus& status, const uint32_t timeMS) override;
+
+        FleetManagerBase* manager = nullptr; /// Manager to forward to
+        uint8_t radio = NO_RADIO; /// Index of the radio
+    };
+
+    /// @brief Forward a status to all listeners unless another radio is responsible for the inverter
+    ///
+    /// @param radio Index of the radio that received the status
+    /// @param status Received status
+    /// @param timeMS Receive time in milliseconds
+    void forwardStatus(const uint8_t radio, const NETSGP::CompactStatus& status, const uint32_t timeMS);
+
+    /// @brief Move the estimated median reply latency of the fleet one step towards a sample
+    void trackMedianRtt(const uint16_t rttMS);
+
+    /// @brief Rate the link of every inverter and move inverters off degraded links
+    void evaluate();
+
+    /// @brief Move one inverter from the most to the least loaded radio if that radio reaches it well
+    ///
+    /// @return true If an inverter was moved
+    /// @return false If the load is even or no inverter fits
+    bool balance();
+
+    /// @brief Expected reply success of an inverter on a radio, not yet rated links are expected to be perfect
+    static uint8_t expectedQuality(const InverterRecord& record, const uint8_t radio);
+
+    /// @brief Move an inverter to another radio, it stays on its radio if the other one does not accept it
+    ///
+    /// @return true If the inverter was moved
+    /// @return false If the other radio did not accept the inverter
+    bool move(InverterRecord& record, const uint8_t radio);
+
+    /// @brief Register an inverter at a radio and remember the current counters as baseline
+    bool assign(InverterRecord& record, const uint8_t radio);
+
+private:
+    AsyncNETSGPClientBase* mRadios[MAX_RADIOS] = {}; /// All radios
+    RadioListener mRadioListeners[MAX_RADIOS]; /// Status listener of every radio
+    uint8_t mRadioCount = 0; /// Amount of radios
+    NETSGP::StatusListener* mListeners[AsyncNETSGPClientBase::MAX_STATUS_LISTENERS] = {}; /// Status listeners
+    uint32_t mForeignID = 0; /// Inverter not in the fleet whose status was forwarded last
+    uint32_t mForeignMS = 0; /// Receive time of that status
+    uint16_t mMedianRttMS = 0; /// Estimated median reply latency of all rated links, 0 if not measured yet
+    NETSGP::DeviceRegistry<InverterRecord> mInverters; /// All inverters
+    Tuning mTuning; /// Tuning of the assignment
+    uint32_t mLastEvaluationMS = 0; /// Time of the last evaluation
+    uint32_t mMoves = 0; /// Moves between radios
+    uint32_t mFailedMoves = 0; /// Moves the target radio did not accept
+};
+
+/// @brief Fleet manager with storage for a fixed maximum amount of inverters
+///
+/// @tparam MaxInverters Maximum amount of inverters in the whole fleet
+template <size_t MaxInverters>
+class BasicFleetManager : public FleetManagerBase
+{
+public:
+    BasicFleetManager() : FleetManagerBase(&mRecords[0], MaxInverters) { }
+
+private:
+    InverterRecord mRecords[MaxInverters]; /// Storage of the device registry
+};
+
+/// @brief Fleet manager for up to 64 inverters
+typedef BasicFleetManager<64> FleetManager;
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Compile-time layouts of all frames exchanged with inverters and the LC12S RF module
+    ///
+    /// Every frame type describes its size, the position of its checksum and its fields as Field types, all multi byte
+    /// fields are big endian. Encoders and decoders are generated from these descriptions, so they compile down to
+    /// plain byte moves without loops or branches. The checksum is the 8 bit sum of all bytes in front of it, so the
+    /// sum of the constant bytes of a frame is known at compile time and only the variable fields are summed when
+    /// encoding. A new command only needs a new layout, not another set of hand counted offsets.
+    namespace Codec
+    {
+        /// @brief Unsigned big endian field of a frame
+        ///
+        /// @tparam Offset Offset of the first byte inside the frame
+        /// @tparam Width Width in bytes (0 - 4)
+        template <uint8_t Offset, uint8_t Width>
+        struct Field
+        {
+            static_assert(Width <= 4, "Fields are at most 32 bit wide");
+
+            constexpr static const uint8_t OFFSET = Offset; /// Offset of the first byte inside the frame
+            constexpr static const uint8_t WIDTH = Width; /// Width in bytes
+            constexpr static const uint8_t END = Offset + Width; /// Offset of the first byte after the field
+
+            /// @brief Read the field from a frame
+            static uint32_t read(const uint8_t* frame)
+            {
+                return Field<Offset, Width - 1>::read(frame) << 8 | frame[END - 1];
+            }
+
+            /// @brief Write a value into the field of a frame, bits not fitting into the field are dropped
+            static void write(uint8_t* frame, const uint32_t value)
+            {
+                Field<Offset, Width - 1>::write(frame, value >> 8);
+                frame[END - 1] = static_cast<uint8_t>(value);
+            }
+
+            /// @brief Get the checksum contribution of a value written into the field
+            constexpr static uint8_t sum(const uint32_t value)
+            {
+                return static_cast<uint8_t>(Field<Offset, Width - 1>::sum(value >> 8) + (value & 0xFF));
+            }
+        };
+
+        /// @brief End of the recursion of Field
+        template <uint8_t Offset>
+        struct Field<Offset, 0>
+        {
+            static uint32_t read(const uint8_t*) { return 0; }
+            static void write(uint8_t*, const uint32_t) { }
+            constexpr static uint8_t sum(const uint32_t) { return 0; }
+        };
+
+        /// @brief Frame of fixed size protected by the 8 bit sum of all bytes in front of the checksum
+        ///
+        /// @tparam Size Size of the frame in bytes
+        /// @tparam ChecksumOffset Offset of the checksum byte
+        template <uint8_t Size, uint8_t ChecksumOffset>
+        struct Layout
+        {
+            static_assert(ChecksumOffset < Size, "The checksum has to be inside the frame");
+
+            constexpr static const uint8_t SIZE = Size; /// Size of the frame in bytes
+            constexpr static const uint8_t CHECKSUM_OFFSET = ChecksumOffset; /// Offset of the checksum byte
+            typedef Field<ChecksumOffset, 1> Checksum; /// Sum of all bytes in front of it
+
+            /// @brief Calculate the checksum of a frame
+            static uint8_t checksum(const uint8_t* frame)
+            {
+                uint8_t crc = 0;
+                for (uint8_t i = 0; i < CHECKSUM_OFFSET; ++i)
+                {
+                    crc += frame[i];
+                }
+                return crc;
+            }
+
+            /// @brief Check the checksum of a frame
+            static bool valid(const uint8_t* frame) { return checksum(frame) == frame[CHECKSUM_OFFSET]; }
+        };
+
+        /// @brief Request to an inverter and the reply to CONTROL and POWER_GRADE (15 bytes)
+        struct CommandFrame : Layout<15, 14>
+        {
+            typedef Field<0, 1> Magic; /// Always MAGIC
+            typedef Field<1, 1> Command; /// Command byte
+            typedef Field<2, 2> DataBoxID; /// Data box identifier, always 0
+            typedef Field<6, 4> DeviceID; /// Inverter identifier
+            typedef Field<13, 1> Value; /// Value of the command, echoed by the reply
+
+            constexpr static const uint8_t MAGIC = 0x43; /// Magic byte indicating start of messages
+            constexpr static const uint8_t CONSTANT_SUM = MAGIC; /// Checksum contribution of the constant bytes
+
+            /// @brief Encode a request
+            ///
+            /// @param frame Destination, at least SIZE bytes
+            /// @param command Command byte
+            /// @param deviceID Recipient inverter identifier
+            /// @param value Value of the command
+            static void encode(uint8_t* frame, const uint8_t command, const uint32_t deviceID, const uint8_t value)
+            {
+                memset(frame, 0, SIZE);
+                Magic::write(frame, MAGIC);
+                Command::write(frame, command);
+                DeviceID::write(frame, deviceID);
+                Value::write(frame, value);
+                Checksum::write(frame, checksum(command, deviceID, value));
+            }
+
+            /// @brief Get the checksum of a request without looking at the encoded bytes
+            constexpr static uint8_t checksum(const uint8_t command, const uint32_t deviceID, const uint8_t value)
+            {
+                return static_cast<uint8_t>(
+                    CONSTANT_SUM + Command::sum(command) + DeviceID::sum(deviceID) + Value::sum(value));
+            }
+            using Layout::checksum;
+        };
+
+        /// @brief Reply to STATUS (27 bytes), the checksum only covers the header and the total generated power
+        struct StatusReply : Layout<27, 14>
+        {
+            typedef Field<0, 1> Magic; /// Always CommandFrame::MAGIC
+            typedef Field<1, 1> Command; /// Command byte
+            typedef Field<6, 4> DeviceID; /// Inverter identifier
+            typedef Field<10, 4> TotalGeneratedPower; /// IEEE 754 bits of the total generated power
+            typedef Field<15, 2> DCVoltage; /// DC voltage in centivolts
+            typedef Field<17, 2> DCCurrent; /// DC current in centiamperes
+            typedef Field<19, 2> ACVoltage; /// AC voltage in centivolts
+            typedef Field<21, 2> ACCurrent; /// AC current in centiamperes
+            typedef Field<25, 1> State; /// Inverter state
+            typedef Field<26, 1> Temperature; /// Inverter temperature
+        };
+
+        /// @brief Read and write settings request of the LC12S RF module and its reply (18 bytes)
+        struct ConfigFrame : Layout<18, 17>
+        {
+            typedef Field<0, 1> Start; /// Always START
+            typedef Field<1, 1> Command; /// Command byte, replies use the command of the request plus one
+            typedef Field<2, 2> ModuleID; /// Unique module identifier
+            typedef Field<4, 2> NetworkID; /// Network identifier
+            typedef Field<7, 1> RFPower; /// RF power
+            typedef Field<9, 1> Baudrate; /// Baudrate
+            typedef Field<11, 1> RFChannel; /// RF channel (0 - 127)
+            typedef Field<15, 1> Length; /// Always SIZE
+
+            constexpr static const uint8_t START = 0xAA; /// First byte of every configuration frame
+            constexpr static const uint8_t CONSTANT_SUM = START + SIZE; /// Checksum contribution of the constant bytes
+
+            /// @brief Encode a configuration request
+            ///
+            /// @param frame Destination, at least SIZE bytes
+            /// @param command Command byte
+            /// @param moduleID Unique module identifier
+            /// @param networkID Network identifier
+            /// @param rfPower RF power
+            /// @param baudrate Baudrate
+            /// @param rfChannel RF channel (0 - 127)
+            static void encode(uint8_t* frame, const uint8_t command, const uint16_t moduleID, const uint16_t networkID,
+                const uint8_t rfPower, const uint8_t baudrate, const uint8_t rfChannel)
+            {
+                memset(frame, 0, SIZE);
+                Start::write(frame, START);
+                Command::write(frame, command);
+                ModuleID::write(frame, moduleID);
+                NetworkID::write(frame, networkID);
+                RFPower::write(frame, rfPower);
+                Baudrate::write(frame, baudrate);
+                RFChannel::write(frame, rfChannel);
+                Length::write(frame, SIZE);
+                Checksum::write(frame,
+                    CONSTANT_SUM + Command::sum(command) + ModuleID::sum(moduleID) + NetworkID::sum(networkID)
+                        + rfPower + baudrate + rfChannel);
+            }
+        };
+
+        static_assert(CommandFrame::DeviceID::OFFSET == StatusReply::DeviceID::OFFSET,
+            "Inverter replies are matched to requests by the device identifier at the same offset");
+        static_assert(CommandFrame::CHECKSUM_OFFSET == StatusReply::CHECKSUM_OFFSET,
+            "Inverter frames are validated before their command is known");
+    } // namespace Codec
+} // namespace NETSGP
@@ -0,0 +1,120 @@
+#include "FrameParser.h"
+
+#include <string.h>
+
+namespace NETSGP
+{
+    uint8_t FrameParser::frameLength(const uint8_t command)
+    {
+        // Lengths of STATUS, CONTROL, unknown and POWER_GRADE replies
+        static const uint8_t lengths[4]
+            = {Codec::StatusReply::SIZE, Codec::CommandFrame::SIZE, 0, Codec::CommandFrame::SIZE};
+        return (command & 0xFC) == 0xC0 ? lengths[command & 0x03] : 0;
+    }
+
+    bool FrameParser::feed(const uint8_t byte)
+    {
+        ++mBytes;
+        if (mFrameReady)
+        {
+            // Keep bytes received after the completed frame, these can only occur after a resync
+            mFrameReady = false;
+            mIndex -= mLength;
+            memmove(&mBuffer[0], &mBuffer[mLength], mIndex);
+            mLength = 0;
+        }
+
+        // Fast path while searching for the start of a frame
+        if (mIndex == 0 && byte != MAGIC_BYTE)
+        {
+            ++mDiscardedBytes;
+            return false;
+        }
+
+        mBuffer[mIndex++] = byte;
+        return process();
+    }
+
+    bool FrameParser::feed(Stream& stream)
+    {
+        while (stream.available() > 0)
+        {
+            const int c = stream.read();
+            if (c < 0)
+            {
+                break;
+            }
+            if (feed(static_cast<uint8_t>(c)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void FrameParser::reset()
+    {
+        mIndex = 0;
+        mLength = 0;
+        mFrameReady = false;
+    }
+
+    void FrameParser::resetCounters()
+    {
+        mBytes = 0;
+        mDiscardedBytes = 0;
+        mCRCErrors = 0;
+    }
+
+    bool FrameParser::process()
+    {
+        while (mIndex > 0)
+        {
+            if (mBuffer[0] != MAGIC_BYTE)
+            {
+                resync();
+                continue;
+            }
+            if (mIndex < 2)
+            {
+                return false;
+            }
+            if (!mLength)
+            {
+                mLength = frameLength(mBuffer[1]);
+                if (!mLength)
+                {
+                    resync();
+                    continue;
+                }
+            }
+            if (mIndex < mLength)
+            {
+                return false;
+            }
+
+            // All known frames carry their checksum at the same offset
+            if (Codec::CommandFrame::valid(&mBuffer[0]))
+            {
+                mFrameReady = true;
+                return true;
+            }
+            ++mCRCErrors;
+            resync();
+        }
+        return false;
+    }
+
+    void FrameParser::resync()
+    {
+        uint8_t next = 1;
+        while (next < mIndex && mBuffer[next] != MAGIC_BYTE)
+        {
+            ++next;
+        }
+        mDiscardedBytes += next;
+        mIndex -= next;
+        memmove(&mBuffer[0], &mBuffer[next], mIndex);
+        mLength = 0;
+    }
+} // namespace NETSGP
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Stream.h>
+
+#include "FrameCodec.h"
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Incremental, non-blocking parser for NETSGP reply frames.
+    ///
+    /// Bytes are consumed one at a time. The parser searches for the magic byte, looks up the frame length from the
+    /// command byte and validates the checksum once a frame is complete. On an unknown command or checksum mismatch
+    /// it drops a single byte and rescans the already received bytes, so a valid frame following garbage is never
+    /// lost.
+    class FrameParser
+    {
+    public:
+        constexpr static const uint8_t MAGIC_BYTE = Codec::CommandFrame::MAGIC; /// Magic byte starting every frame
+        constexpr static const uint8_t MAX_FRAME_SIZE = Codec::StatusReply::SIZE; /// Size of the largest known frame
+
+    public:
+        /// @brief Get the length of a frame with the given command byte
+        ///
+        /// @param command Command byte of the frame
+        /// @return uint8_t Frame length in bytes or 0 if the command is unknown
+        static uint8_t frameLength(const uint8_t command);
+
+        /// @brief Feed a single byte into the parser.
+        ///
+        /// A previously completed frame is discarded on the next call.
+        /// @param byte The received byte
+        /// @return true If a complete and valid frame is available through frame()
+        /// @return false If not
+        bool feed(const uint8_t byte);
+
+        /// @brief Feed all currently available bytes of a stream into the parser without blocking.
+        ///
+        /// Stops right after a complete frame, so remaining bytes stay in the stream for the next call.
+        /// @param stream Stream to read from
+        /// @return true If a complete and valid frame is available through frame()
+        /// @return false If the stream ran out of bytes before
+        bool feed(Stream& stream);
+
+        /// @brief Discard all buffered bytes and any completed frame
+        void reset();
+
+        /// @brief Reset all counters
+        void resetCounters();
+
+        /// @brief Is a complete frame available
+        bool hasFrame() const { return mFrameReady; }
+
+        /// @brief Get the completed frame, only valid if hasFrame() is true
+        const uint8_t* frame() const { return &mBuffer[0]; }
+
+        /// @brief Get the length of the completed frame, only valid if hasFrame() is true
+        uint8_t length() const { return mLength; }
+
+        /// @brief Get the command byte of the completed frame, only valid if hasFrame() is true
+        uint8_t command() const { return Codec::CommandFrame::Command::read(&mBuffer[0]); }
+
+        /// @brief Get the amount of bytes fed into the parser
+        uint32_t bytes() const { return mBytes; }
+
+        /// @brief Get the amount of bytes dropped while searching for frames
+        uint32_t discardedBytes() const { return mDiscardedBytes; }
+
+        /// @brief Get the amount of complete frames dropped because of a checksum mismatch
+        uint32_t crcErrors() const { return mCRCErrors; }
+
+    private:
+        /// @brief Try to form a frame from the buffered bytes, dropping bytes that can not start one
+        ///
+        /// @return true If a complete and valid frame starts at mBuffer[0]
+        /// @return false If more bytes are needed
+        bool process();
+
+        /// @brief Drop the first buffered byte and everything up to the next magic byte
+        void resync();
+
+    private:
+        uint8_t mBuffer[MAX_FRAME_SIZE] = {0}; /// Bytes of the frame currently being received
+        uint8_t mIndex = 0; /// Amount of bytes in mBuffer
+        uint8_t mLength = 0; /// Length of the frame in mBuffer or 0 if not yet known
+        bool mFrameReady = false; /// Does mBuffer contain a complete and valid frame
+        uint32_t mBytes = 0; /// Bytes fed into the parser
+        uint32_t mDiscardedBytes = 0; /// Bytes dropped while searching for frames
+        uint32_t mCRCErrors = 0; /// Frames dropped due to checksum mismatch
+    };
+} // namespace NETSGP
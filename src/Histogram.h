@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Power of two histogram with saturating counters
+    ///
+    /// Bucket 0 counts the value 0, bucket i counts values from 2^(i-1) to 2^i - 1 and the last bucket counts all
+    /// values from 2^(BUCKETS-2) upwards.
+    /// @tparam Count Counter type
+    template <typename Count>
+    struct Histogram
+    {
+        constexpr static const size_t BUCKETS = 12; /// Amount of buckets
+
+        Count counts[BUCKETS]; /// Counters of all buckets
+
+        /// @brief Count a value
+        void add(uint32_t value)
+        {
+            size_t bucket = 0;
+            while (value && bucket < BUCKETS - 1)
+            {
+                value >>= 1;
+                ++bucket;
+            }
+            if (static_cast<Count>(counts[bucket] + 1) != 0)
+            {
+                ++counts[bucket];
+            }
+        }
+
+        /// @brief Get the total amount of counted values
+        uint32_t total() const
+        {
+            uint32_t sum = 0;
+            for (const Count count : counts)
+            {
+                sum += count;
+            }
+            return sum;
+        }
+
+        /// @brief Get the largest value counted in a bucket, the last bucket is unbounded
+        static uint32_t upperBound(const size_t bucket) { return bucket ? (1UL << bucket) - 1 : 0; }
+
+        /// @brief Get an upper bound of the given percentile
+        ///
+        /// @param percent Percentile from 0 to 100
+        /// @return uint32_t Upper bound of the bucket containing the percentile, 0 if empty
+        uint32_t percentile(const uint8_t percent) const
+        {
+            const uint32_t target = (static_cast<uint64_t>(total()) * percent + 99) / 100;
+            uint32_t sum = 0;
+            for (size_t i = 0; i < BUCKETS; ++i)
+            {
+                sum += counts[i];
+                if (sum && sum >= target)
+                {
+                    return upperBound(i);
+                }
+            }
+            return 0;
+        }
+
+        /// @brief Reset all counters
+        void clear()
+        {
+            for (Count& count : counts)
+            {
+                count = 0;
+            }
+        }
+    };
+} // namespace NETSGP
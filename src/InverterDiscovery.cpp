@@ -0,0 +1,205 @@
+#include "InverterDiscovery.h"
+
+#include <Arduino.h>
+
+namespace
+{
+    /// @brief Identifier prefixes of the models listed in the README
+    const uint8_t KNOWN_PREFIXES[] = {0x11, 0x19, 0x34, 0x38, 0x41, 0x48, 0x52};
+} // namespace
+
+InverterDiscovery::InverterDiscovery(AsyncNETSGPClientBase& client)
+    : mClient(client), mListening(client.addStatusListener(*this))
+{ }
+
+InverterDiscovery::~InverterDiscovery()
+{
+    mClient.removeStatusListener(*this);
+}
+
+size_t InverterDiscovery::knownRanges(Range* ranges, const size_t capacity, const uint32_t lastSerial)
+{
+    size_t count = 0;
+    for (const uint8_t prefix : KNOWN_PREFIXES)
+    {
+        if (count >= capacity)
+        {
+            break;
+        }
+        const uint32_t base = static_cast<uint32_t>(prefix) << 24;
+        ranges[count++] = {base | 1, base | (lastSerial & 0x00FFFFFF)};
+    }
+    return count;
+}
+
+bool InverterDiscovery::setRanges(const Range* ranges, const size_t count)
+{
+    if (mScanning)
+    {
+        return false;
+    }
+    mRangeCount = count < MAX_RANGES ? count : MAX_RANGES;
+    for (size_t i = 0; i < mRangeCount; ++i)
+    {
+        mRanges[i] = ranges[i];
+    }
+    mNextID = 0;
+    mSent = false;
+    return true;
+}
+
+bool InverterDiscovery::start(const uint32_t resumeID)
+{
+    if (mScanning || mRangeCount == 0 || resumeID == FINISHED)
+    {
+        return false;
+    }
+    // Without status callbacks no reply would ever be seen, try again in case a slot became free
+    mListening = mListening || mClient.addStatusListener(*this);
+    if (!mListening)
+    {
+        DEBUGLN("[InverterDiscovery] No free status listener slot");
+        return false;
+    }
+    mRange = 0;
+    while (mRange < mRangeCount && mRanges[mRange].last < resumeID)
+    {
+        ++mRange;
+    }
+    if (mRange == mRangeCount)
+    {
+        return false;
+    }
+
+    const uint32_t first = resumeID > mRanges[mRange].first ? resumeID : mRanges[mRange].first;
+    mSent = false;
+    if (!candidate(first, mNextID) || mNextID > mRanges[mRange].last)
+    {
+        // The range holds no candidate at all
+        mNextID = mRanges[mRange].last;
+        advance();
+    }
+    mPendingHead = 0;
+    mPendingCount = 0;
+    mProbes = 0;
+    mFound = 0;
+    mLastProbeMS = millis() - mTuning.probeIntervalMS;
+    mScanning = true;
+    return true;
+}
+
+uint32_t InverterDiscovery::cursor() const
+{
+    if (mPendingCount)
+    {
+        return mPending[mPendingHead].deviceID;
+    }
+    return mSent ? FINISHED : mNextID;
+}
+
+void InverterDiscovery::update()
+{
+    if (!mScanning)
+    {
+        return;
+    }
+
+    // Probes whose reply window passed are settled, the cursor moves behind them
+    const uint32_t currentMillis = millis();
+    while (mPendingCount && currentMillis - mPending[mPendingHead].sentMS >= mTuning.replyWindowMS)
+    {
+        mPendingHead = (mPendingHead + 1) % MAX_PENDING;
+        --mPendingCount;
+    }
+
+    if (mSent)
+    {
+        mScanning = mPendingCount != 0;
+        return;
+    }
+    if (mPendingCount >= MAX_PENDING || currentMillis - mLastProbeMS < mTuning.probeIntervalMS
+        || !mClient.sendProbe(mNextID, mTuning.probeTimeoutMS))
+    {
+        return;
+    }
+
+    mPending[(mPendingHead + mPendingCount) % MAX_PENDING] = {mNextID, currentMillis};
+    ++mPendingCount;
+    ++mProbes;
+    mLastProbeMS = currentMillis;
+    advance();
+}
+
+void InverterDiscovery::onStatus(const NETSGP::CompactStatus& status, const uint32_t)
+{
+    if (!mScanning)
+    {
+        return;
+    }
+    bool inRange = false;
+    for (size_t i = 0; i < mRangeCount && !inRange; ++i)
+    {
+        inRange = status.deviceID >= mRanges[i].first && status.deviceID <= mRanges[i].last;
+    }
+    if (!inRange)
+    {
+        return;
+    }
+
+    // Registering an inverter that is already known does not change the count
+    const size_t count = mClient.inverterCount();
+    const bool registered = mClient.registerInverter(status.deviceID);
+    if (registered && mClient.inverterCount() == count)
+    {
+        return;
+    }
+    DEBUGF("[InverterDiscovery] Found %#08x\n", status.deviceID);
+    ++mFound;
+    if (mCallback)
+    {
+        mCallback(status.deviceID, registered);
+    }
+}
+
+bool InverterDiscovery::candidate(const uint32_t deviceID, uint32_t& candidate) const
+{
+    candidate = deviceID;
+    if (!mTuning.decimalOnly)
+    {
+        return true;
+    }
+    // Turn every hex digit into a carry to the next digit, e.g. 0x1100009A becomes 0x11000100
+    for (uint8_t shift = 0; shift < 32; shift += 4)
+    {
+        const uint32_t digit = (candidate >> shift) & 0xF;
+        if (digit > 9)
+        {
+            const uint32_t next = candidate + ((0x10 - digit) << shift);
+            if (next < candidate)
+            {
+                return false;
+            }
+            candidate = next & ~((1UL << shift) - 1);
+        }
+    }
+    return true;
+}
+
+void InverterDiscovery::advance()
+{
+    uint32_t next;
+    if (mNextID < mRanges[mRange].last && candidate(mNextID + 1, next) && next <= mRanges[mRange].last)
+    {
+        mNextID = next;
+        return;
+    }
+    while (++mRange < mRangeCount)
+    {
+        if (candidate(mRanges[mRange].first, next) && next <= mRanges[mRange].last)
+        {
+            mNextID = next;
+            return;
+        }
+    }
+    mSent = true;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "AsyncNETSGPClient.h"
+#include "StatusListener.h"
+
+/// @brief Finds inverters by probing ranges of device identifiers and registers every one that replies
+///
+/// Probes are STATUS requests sent with AsyncNETSGPClient::sendProbe() every probeIntervalMS. Each probe takes an in
+/// flight slot of the client like a regular request, but only until its reply or for probeTimeoutMS, so with
+/// AsyncNETSGPClientBase::setMaxInFlight() above one several probes overlap and identifiers without an inverter cost
+/// a short probe timeout instead of a full reply timeout. Regular polling of the client continues in between and
+/// shares the slots, a probe that finds no free slot is sent by a later update(). At 9600 baud and next to the polls
+/// of a few inverters a single slot scans about 3 identifiers per second and four slots about 20, so ten thousand
+/// identifiers take roughly ten minutes with four slots. Replies arriving after probeTimeoutMS still count until
+/// replyWindowMS has passed.
+///
+/// The scan can be resumed after a reboot: save cursor() now and then, e.g. from the found callback or every minute,
+/// and pass it to start(). Every identifier below the cursor was probed and its reply window has passed. Each
+/// identifier is probed once, on a lossy link repeat the scan to catch inverters whose probe or reply got lost.
+/// @note Inverters only answer on the RF channel and network they were built for, run a ChannelSurvey first if the
+/// module settings are unknown.
+class InverterDiscovery : public NETSGP::StatusListener
+{
+public:
+    /// @brief Inclusive range of device identifiers to probe
+    struct Range
+    {
+        uint32_t first; /// First identifier to probe
+        uint32_t last; /// Last identifier to probe
+    };
+
+    /// @brief Tuning of the scan
+    struct Tuning
+    {
+        uint16_t probeIntervalMS = 20; /// Time between two probes, a request takes 16 ms on the wire at 9600 baud
+        uint16_t probeTimeoutMS = AsyncNETSGPClientBase::PROBE_TIMEOUT_MS; /// Time a probe holds an in flight slot
+        uint16_t replyWindowMS = 500; /// Time a reply to a probe may take before the probe counts as unanswered
+        bool decimalOnly = false; /// Skip identifiers with hex digits A - F, labels only show digits 0 - 9
+    };
+
+    /// @brief Callback function type definition for found inverters
+    ///
+    /// @param deviceID Identifier of the inverter
+    /// @param registered Was the inverter registered, false if the client is full
+    typedef void (*FoundCallback)(const uint32_t deviceID, const bool registered);
+
+    constexpr static const size_t MAX_RANGES = 8; /// Maximum amount of ranges
+    constexpr static const size_t MAX_PENDING = 32; /// Maximum amount of probes waiting for their reply window
+    constexpr static const uint32_t FINISHED = 0xFFFFFFFF; /// cursor() after all ranges were probed
+
+public:
+    /// @brief Construct a new InverterDiscovery object and add it as status listener of the client
+    ///
+    /// @param client Client to send the probes and to register found inverters with
+    explicit InverterDiscovery(AsyncNETSGPClientBase& client);
+
+    /// @brief Remove the discovery from the status listeners of the client
+    ~InverterDiscovery();
+
+    InverterDiscovery(const InverterDiscovery&) = delete;
+    InverterDiscovery& operator=(const InverterDiscovery&) = delete;
+
+    /// @brief Fill ranges below the identifier prefixes of all known models, e.g. 0x11000001 - 0x11009999
+    ///
+    /// @param ranges Ranges to fill
+    /// @param capacity Amount of available ranges
+    /// @param lastSerial Last serial number below each prefix, e.g. 0x9999
+    /// @return size_t Amount of filled ranges
+    static size_t knownRanges(Range* ranges, const size_t capacity, const uint32_t lastSerial);
+
+    /// @brief Set the ranges to probe, only while no scan is running
+    ///
+    /// @param ranges Ranges to probe in ascending order of their identifiers
+    /// @param count Amount of ranges, at most MAX_RANGES are used
+    /// @return true If the ranges were set
+    /// @return false If a scan is running
+    bool setRanges(const Range* ranges, const size_t count);
+
+    /// @brief Change the tuning of the scan
+    void setTuning(const Tuning& tuning) { mTuning = tuning; }
+
+    /// @brief Set the callback for found inverters
+    ///
+    /// @param callback Callback that gets called for every inverter that was not registered before, may be nullptr
+    void setFoundCallback(FoundCallback callback) { mCallback = callback; }
+
+    /// @brief Start a scan
+    ///
+    /// @param resumeID Cursor saved from an earlier scan, 0 to start at the first range
+    /// @return true If the scan was started
+    /// @return false If a scan is running, no ranges are set, resumeID is behind the last range or the discovery is no
+    /// status listener of the client because all MAX_STATUS_LISTENERS slots are taken
+    bool start(const uint32_t resumeID = 0);
+
+    /// @brief Stop the running scan, cursor() stays valid for resuming it
+    void stop() { mScanning = false; }
+
+    /// @brief Is a scan running
+    bool scanning() const { return mScanning; }
+
+    /// @brief Get the first identifier not completely probed yet, FINISHED after all ranges were probed
+    uint32_t cursor() const;
+
+    /// @brief Get the amount of probes sent by the running or last scan
+    uint32_t probes() const { return mProbes; }
+
+    /// @brief Get the amount of inverters found by the running or last scan
+    uint32_t found() const { return mFound; }
+
+    /// @brief Send the next probe when it is due
+    /// @note Needs to be called inside loop(), the client needs its own update() calls too
+    void update();
+
+    void onStatus(const NETSGP::CompactStatus& status, const uint32_t timeMS) override;
+
+private:
+    /// @brief A probe waiting for its reply window to pass
+    struct Pending
+    {
+        uint32_t deviceID; /// Probed identifier
+        uint32_t sentMS; /// Send time in milliseconds
+    };
+
+    /// @brief Get the first candidate identifier not less than the given one, skipping hex digits if decimalOnly
+    ///
+    /// @param deviceID Identifier to start from
+    /// @param candidate Candidate to fill
+    /// @return true If there is a candidate
+    /// @return false If the identifiers overflowed
+    bool candidate(const uint32_t deviceID, uint32_t& candidate) const;
+
+    /// @brief Move to the next candidate identifier, to the next range after the last one of a range
+    void advance();
+
+private:
+    AsyncNETSGPClientBase& mClient; /// Client sending the probes
+    bool mListening; /// Is the discovery a status listener of the client
+    Tuning mTuning; /// Tuning of the scan
+    FoundCallback mCallback = nullptr; /// Callback for found inverters
+    Range mRanges[MAX_RANGES] = {}; /// Ranges to probe
+    size_t mRangeCount = 0; /// Amount of ranges
+    size_t mRange = 0; /// Index of the range being probed
+    uint32_t mNextID = 0; /// Next identifier to probe
+    bool mScanning = false; /// Is a scan running
+    bool mSent = false; /// Were all identifiers probed
+    uint32_t mLastProbeMS = 0; /// Send time of the last probe
+    Pending mPending[MAX_PENDING] = {}; /// Ring of probes waiting for their reply window
+    size_t mPendingHead = 0; /// Index of the oldest pending probe
+    size_t mPendingCount = 0; /// Amount of pending probes
+    uint32_t mProbes = 0; /// Probes sent by the running or last scan
+    uint32_t mFound = 0; /// Inverters found by the running or last scan
+};
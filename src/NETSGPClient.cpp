@@ -1,5 +1,7 @@
 #include "NETSGPClient.h"
 
+#include <string.h>
+
 #include <Arduino.h>
 
 NETSGPClient::NETSGPClient(Stream& stream, const uint8_t progPin) : mStream(stream), mProgPin(progPin)
@@ -14,7 +16,7 @@ NETSGPClient::InverterStatus NETSGPClient::getStatus(const uint32_t deviceID)
 {
     sendCommand(deviceID, Command::STATUS);
     InverterStatus status;
-    if (waitForMessage() && findAndReadReply(Command::STATUS))
+    if (waitForReply(Command::STATUS))
     {
         fillInverterStatusFromBuffer(&mBuffer[0], status);
     }
@@ -40,132 +42,155 @@ bool NETSGPClient::reboot(const uint32_t deviceID)
     return sendCommandAndValidate(deviceID, Command::CONTROL, Control::REBOOT);
 }
 
-LC12S::Settings NETSGPClient::readRFModuleSettings()
+NETSGPClient::InverterStatus NETSGPClient::toInverterStatus(const NETSGP::CompactStatus& compact)
 {
-    uint8_t* bufferPointer = &mBuffer[0];
-
-    *bufferPointer++ = 0xAA; // command byte
-    *bufferPointer++ = 0x5C; // command byte
-    *bufferPointer++ = 0x00; // module identifier
-    *bufferPointer++ = 0x00; // module identifier
-    *bufferPointer++ = 0x00; // networking identifier
-    *bufferPointer++ = 0x00; // networking identifier
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x00; // RF power
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x00; // Baudrate
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x00; // RF channel (0 - 127)
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x12; // Length
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x18; // Checksum
-
-    enableProgramming();
+    InverterStatus status;
+    status.deviceID = compact.deviceID;
+    status.state = compact.state; // not fully reversed
+    status.temperature = compact.temperature; // not fully reversed
+    status.valid = true;
+    status.totalGeneratedPower = compact.totalGeneratedPower();
+    status.dcVoltage = compact.dcVoltageV();
+    status.dcCurrent = compact.dcCurrentA();
+    status.dcPower = status.dcVoltage * status.dcCurrent;
+    status.acVoltage = compact.acVoltageV();
+    status.acCurrent = compact.acCurrentA();
+    status.acPower = status.acVoltage * status.acCurrent;
+    return status;
+}
 
-    mStream.write(&mBuffer[0], 18);
-    const size_t read = mStream.readBytes(&mBuffer[0], 18);
+NETSGPClient::LinkStatistics NETSGPClient::getStatistics() const
+{
+    LinkStatistics statistics = mStatistics;
+    statistics.bytesIn += mParser.bytes();
+    statistics.crcErrors = mParser.crcErrors();
+    statistics.discardedBytes = mParser.discardedBytes();
+    return statistics;
+}
 
-    disableProgramming();
+void NETSGPClient::resetStatistics()
+{
+    mStatistics = {};
+    mParser.resetCounters();
+}
 
+LC12S::Settings NETSGPClient::readRFModuleSettings()
+{
+    enableProgramming();
     LC12S::Settings settings;
-    if (read == 18 && mBuffer[0] == 0xAA && mBuffer[1] == 0x5D && mBuffer[17] == calcCRC(17))
-    {
-        settings.valid = true;
-
-        settings.moduleID = mBuffer[2] << 8 | (mBuffer[3] & 0xFF);
-        settings.networkID = mBuffer[4] << 8 | (mBuffer[5] & 0xFF);
-        settings.rfPower = static_cast<LC12S::RFPower>(mBuffer[7]);
-        settings.baudrate = static_cast<LC12S::Baudrate>(mBuffer[9]);
-        settings.rfChannel = mBuffer[11];
-    }
-    else
-    {
-        settings.valid = false;
-    }
+    configTransaction(CONFIG_READ, LC12S::Settings(), settings);
+    disableProgramming();
     return settings;
 }
 
 bool NETSGPClient::writeRFModuleSettings(const LC12S::Settings& settings)
 {
-    uint8_t* bufferPointer = &mBuffer[0];
-
-    *bufferPointer++ = 0xAA; // command byte
-    *bufferPointer++ = 0x5A; // command byte
-    *bufferPointer++ = (settings.moduleID >> 8) & 0xFF; // module identifier
-    *bufferPointer++ = settings.moduleID & 0xFF; // module identifier
-    *bufferPointer++ = (settings.networkID >> 8) & 0xFF; // networking identifier
-    *bufferPointer++ = settings.networkID & 0xFF; // networking identifier
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = settings.rfPower; // RF power
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = settings.baudrate; // Baudrate
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = settings.rfChannel; // RF channel (0 - 127)
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = 0x12; // Length
-    *bufferPointer++ = 0x00; // NC must be 0
-    *bufferPointer++ = calcCRC(16); // Checksum, we can calc for 16 bytes since 17th one is 0
-
     enableProgramming();
+    LC12S::Settings written;
+    const bool success = configTransaction(CONFIG_WRITE, settings, written);
+    disableProgramming();
+    return success;
+}
 
-    mStream.write(&mBuffer[0], 18);
-    const size_t read = mStream.readBytes(&mBuffer[0], 18);
+bool NETSGPClient::applyRFModuleSettings(const LC12S::Settings& settings)
+{
+    LC12S::Settings target = settings;
+    target.valid = true;
+    if (mModuleSettings == target)
+    {
+        return true;
+    }
 
+    // Read and write in one go, so programming mode is only entered once
+    enableProgramming();
+    LC12S::Settings current;
+    bool success = configTransaction(CONFIG_READ, LC12S::Settings(), current);
+    if (success && current != target)
+    {
+        // Keep the moduleID since that is unique for each module
+        target.moduleID = current.moduleID;
+        success = configTransaction(CONFIG_WRITE, target, current);
+    }
     disableProgramming();
-
-    return read == 18 && mBuffer[0] == 0xAA && mBuffer[1] == 0x5B && mBuffer[17] == calcCRC(17);
+    return success;
 }
 
 bool NETSGPClient::setDefaultRFSettings()
 {
-    LC12S::Settings settings = readRFModuleSettings();
-    if (settings != LC12S::DEFAULT_SETTINGS)
+    return applyRFModuleSettings(LC12S::DEFAULT_SETTINGS);
+}
+
+bool NETSGPClient::negotiateBaudrate(HostBaudrateCallback setHostBaudrate, const uint32_t probeDeviceID,
+    LC12S::Baudrate& baudrate, const LC12S::Baudrate maxBaudrate)
+{
+    const LC12S::Settings current = readRFModuleSettings();
+    if (!current.valid)
+    {
+        return false;
+    }
+    baudrate = current.baudrate;
+
+    for (int candidate = maxBaudrate; candidate > current.baudrate; --candidate)
     {
-        // Copy over default settings without moduleID since that is uinque for each module
-        settings.networkID = LC12S::DEFAULT_SETTINGS.networkID;
-        settings.rfPower = LC12S::DEFAULT_SETTINGS.rfPower;
-        settings.baudrate = LC12S::DEFAULT_SETTINGS.baudrate;
-        settings.rfChannel = LC12S::DEFAULT_SETTINGS.rfChannel;
-        return writeRFModuleSettings(settings);
+        LC12S::Settings settings = current;
+        settings.baudrate = static_cast<LC12S::Baudrate>(candidate);
+        // The module acknowledges at the old baudrate and switches afterwards
+        const bool written = writeRFModuleSettings(settings);
+        setHostBaudrate(LC12S::baudrateToBps(settings.baudrate));
+        flushInput();
+        if (written && verifyLink(settings.baudrate, probeDeviceID))
+        {
+            DEBUGF("[negotiateBaudrate] Using %u baud\n", LC12S::baudrateToBps(settings.baudrate));
+            baudrate = settings.baudrate;
+            return true;
+        }
+
+        DEBUGF("[negotiateBaudrate] %u baud failed\n", LC12S::baudrateToBps(settings.baudrate));
+        // Restore the old baudrate, from the new one if the module switched and from the old one if it did not
+        writeRFModuleSettings(current);
+        setHostBaudrate(LC12S::baudrateToBps(current.baudrate));
+        flushInput();
+        if (!verifyLink(current.baudrate, 0) && !(writeRFModuleSettings(current) && verifyLink(current.baudrate, 0)))
+        {
+            // Lost the module, find out where it went
+            return detectBaudrate(setHostBaudrate, baudrate);
+        }
     }
     return true;
 }
 
+bool NETSGPClient::detectBaudrate(HostBaudrateCallback setHostBaudrate, LC12S::Baudrate& baudrate)
+{
+    // Most likely the default first, then from fast to slow
+    const LC12S::Baudrate order[] = {LC12S::BPS_9600, LC12S::BPS_38400, LC12S::BPS_19200, LC12S::BPS_4800,
+        LC12S::BPS_2400, LC12S::BPS_1200, LC12S::BPS_600};
+    for (const LC12S::Baudrate candidate : order)
+    {
+        setHostBaudrate(LC12S::baudrateToBps(candidate));
+        flushInput();
+        if (verifyLink(candidate, 0))
+        {
+            baudrate = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
 void NETSGPClient::sendCommand(const uint32_t deviceID, const Command command, const uint8_t value)
 {
-    uint8_t* bufferPointer = &mBuffer[0];
-
-    *bufferPointer++ = MAGIC_BYTE;
-    *bufferPointer++ = command;
-    *bufferPointer++ = 0x00; // data box ID
-    *bufferPointer++ = 0x00; // data box ID
-    *bufferPointer++ = 0x00;
-    *bufferPointer++ = 0x00;
-    *bufferPointer++ = (deviceID >> 24) & 0xFF;
-    *bufferPointer++ = (deviceID >> 16) & 0xFF;
-    *bufferPointer++ = (deviceID >> 8) & 0xFF;
-    *bufferPointer++ = deviceID & 0xFF;
-    *bufferPointer++ = 0x00;
-    *bufferPointer++ = 0x00;
-    *bufferPointer++ = 0x00;
-    *bufferPointer++ = value;
-    *bufferPointer++ = calcCRC(14);
-
-    mStream.write(&mBuffer[0], 15);
+    NETSGP::Codec::CommandFrame::encode(&mBuffer[0], command, deviceID, value);
+    mStatistics.bytesOut += mStream.write(&mBuffer[0], NETSGP::Codec::CommandFrame::SIZE);
+    ++mStatistics.requests;
 }
 
 bool NETSGPClient::sendCommandAndValidate(const uint32_t deviceID, const Command command, const uint8_t value)
 {
     sendCommand(deviceID, command, value);
-    if (waitForMessage() && findAndReadReply(command))
+    if (waitForReply(command))
     {
-        const bool crc = mBuffer[14] == calcCRC(14);
-        const bool valid = mBuffer[13] == value;
+        const bool crc = NETSGP::Codec::CommandFrame::valid(&mBuffer[0]);
+        const bool valid = NETSGP::Codec::CommandFrame::Value::read(&mBuffer[0]) == value;
 
         DEBUGF("[sendCommandAndValidate] CRC %s & value %s\n", crc ? "valid" : "invalid", valid ? "valid" : "invalid");
 
@@ -175,73 +200,63 @@ bool NETSGPClient::sendCommandAndValidate(const uint32_t deviceID, const Command
     return false;
 }
 
-bool NETSGPClient::waitForMessage()
+bool NETSGPClient::waitForReply(const Command command)
 {
     const uint32_t startTime = millis();
     while (millis() - startTime < 1000)
     {
-        if (mStream.available())
+        if (findAndReadReply(command))
         {
+            countReply(millis() - startTime);
             return true;
         }
         delay(1);
     }
-    DEBUGLN("[waitForMessage] Timeout");
+    ++mStatistics.timeouts;
+    DEBUGLN("[waitForReply] Timeout");
     return false;
 }
 
 bool NETSGPClient::findAndReadReply(const Command command)
 {
-    // Search for a reply header consisting of magic byte and one of the command bytes
-    const char header[2] = {MAGIC_BYTE, command};
-    if (!mStream.find(&header[0], 2))
-    {
-        DEBUGLN("[findAndReadReply] Could not find header");
-        return false;
-    }
-
-    size_t bytesToRead;
-    switch (command)
+    while (readReply())
     {
-    case Command::STATUS:
-        // whole message is 27 bytes
-        bytesToRead = 25;
-        break;
-    case Command::CONTROL:
-    case Command::POWER_GRADE:
-        // whole message is 15 bytes
-        bytesToRead = 13;
-        break;
-    default:
-        bytesToRead = 0;
-        DEBUGLN("[findAndReadReply] Unknown command");
-        break;
+        const uint8_t replyCommand = NETSGP::Codec::CommandFrame::Command::read(&mBuffer[0]);
+        if (replyCommand == command)
+        {
+            return true;
+        }
+        DEBUGF("[findAndReadReply] Dropping reply with command %#02x\n", replyCommand);
     }
+    return false;
+}
 
-    if (bytesToRead)
+bool NETSGPClient::readReply()
+{
+    if (mParser.feed(mStream))
     {
-        const size_t bytesRead = mStream.readBytes(&mBuffer[2], bytesToRead);
-        dumpBuffer(2 + bytesRead);
-        return bytesRead == bytesToRead;
+        memcpy(&mBuffer[0], mParser.frame(), mParser.length());
+        dumpBuffer(mParser.length());
+        return true;
     }
-
     return false;
 }
 
-uint8_t NETSGPClient::calcCRC(const size_t bytes) const
+void NETSGPClient::countCallback(const uint32_t startMicros)
 {
-    uint8_t crc = 0;
-    for (size_t i = 0; i < bytes; ++i)
+    const uint32_t elapsed = micros() - startMicros;
+    ++mStatistics.callbacks;
+    mStatistics.callbackMicros.add(elapsed);
+    if (elapsed > mStatistics.callbackMaxMicros)
     {
-        crc += mBuffer[i];
+        mStatistics.callbackMaxMicros = elapsed;
     }
-    return crc;
 }
 
 void NETSGPClient::enableProgramming()
 {
     digitalWrite(mProgPin, LOW);
-    delay(400);
+    delay(PROGRAMMING_DELAY_MS);
 }
 
 void NETSGPClient::disableProgramming()
@@ -249,32 +264,97 @@ void NETSGPClient::disableProgramming()
     digitalWrite(mProgPin, HIGH);
 }
 
-bool NETSGPClient::fillInverterStatusFromBuffer(const uint8_t* buffer, InverterStatus& status)
+void NETSGPClient::buildConfigFrame(const uint8_t command, const LC12S::Settings& settings)
 {
-    status.deviceID = buffer[6] << 24 | buffer[7] << 16 | buffer[8] << 8 | (buffer[9] & 0xFF);
+    // A read request carries no settings
+    const LC12S::Settings values = command == CONFIG_WRITE ? settings : LC12S::Settings();
+    NETSGP::Codec::ConfigFrame::encode(&mConfigBuffer[0], command, values.moduleID, values.networkID, values.rfPower,
+        values.baudrate, values.rfChannel);
+}
 
-    const uint32_t tempTotal = buffer[10] << 24 | buffer[11] << 16 | buffer[12] << 8 | (buffer[13] & 0xFF);
-    status.totalGeneratedPower = *((float*)&tempTotal);
+bool NETSGPClient::parseConfigReply(const uint8_t command, LC12S::Settings& settings)
+{
+    typedef NETSGP::Codec::ConfigFrame Frame;
+    const uint8_t* frame = &mConfigBuffer[0];
+    // Replies use the command of the request plus one
+    if (Frame::Start::read(frame) != Frame::START || Frame::Command::read(frame) != command + 1u
+        || !Frame::valid(frame))
+    {
+        settings.valid = false;
+        return false;
+    }
 
-    status.dcVoltage = (buffer[15] << 8 | buffer[16]) / 100.0f;
-    status.dcCurrent = (buffer[17] << 8 | buffer[18]) / 100.0f;
-    status.dcPower = status.dcVoltage * status.dcCurrent;
+    settings.valid = true;
+    settings.moduleID = Frame::ModuleID::read(frame);
+    settings.networkID = Frame::NetworkID::read(frame);
+    settings.rfPower = static_cast<LC12S::RFPower>(Frame::RFPower::read(frame));
+    settings.baudrate = static_cast<LC12S::Baudrate>(Frame::Baudrate::read(frame));
+    settings.rfChannel = Frame::RFChannel::read(frame);
+    mModuleSettings = settings;
+    return true;
+}
 
-    status.acVoltage = (buffer[19] << 8 | buffer[20]) / 100.0f;
-    status.acCurrent = (buffer[21] << 8 | buffer[22]) / 100.0f;
-    status.acPower = status.acVoltage * status.acCurrent;
+bool NETSGPClient::configTransaction(const uint8_t command, const LC12S::Settings& settings, LC12S::Settings& reply)
+{
+    buildConfigFrame(command, settings);
+    mStatistics.bytesOut += mStream.write(&mConfigBuffer[0], CONFIG_FRAME_SIZE);
+    const size_t read = mStream.readBytes(&mConfigBuffer[0], CONFIG_FRAME_SIZE);
+    mStatistics.bytesIn += read;
+    if (read != CONFIG_FRAME_SIZE)
+    {
+        reply.valid = false;
+        return false;
+    }
+    return parseConfigReply(command, reply);
+}
 
-    status.state = buffer[25]; // not fully reversed
+bool NETSGPClient::verifyLink(const LC12S::Baudrate baudrate, const uint32_t probeDeviceID)
+{
+    const LC12S::Settings settings = readRFModuleSettings();
+    if (!settings.valid || settings.baudrate != baudrate)
+    {
+        return false;
+    }
+    if (probeDeviceID == 0)
+    {
+        return true;
+    }
+    // A single lost frame must not cost the higher baudrate
+    for (uint8_t attempt = 0; attempt < 3; ++attempt)
+    {
+        if (getStatus(probeDeviceID).valid)
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
-    status.temperature = buffer[26]; // not fully reversed
+void NETSGPClient::flushInput()
+{
+    while (mStream.read() >= 0)
+    {
+        ++mStatistics.bytesIn;
+    }
+    mParser.reset();
+}
 
-    status.valid = buffer[14] == calcCRC(14);
+bool NETSGPClient::fillInverterStatusFromBuffer(const uint8_t* buffer, InverterStatus& status)
+{
+    const NETSGP::StatusFrame frame(buffer);
+    status = toInverterStatus(frame.compact());
+    status.valid = frame.valid();
 
     DEBUGF("CRC %s\n", status.valid ? "valid" : "invalid");
 
     return status.valid;
 }
 
+uint32_t NETSGPClient::deviceIDFromBuffer(const uint8_t* buffer)
+{
+    return NETSGP::Codec::CommandFrame::DeviceID::read(buffer);
+}
+
 void NETSGPClient::dumpBuffer(const size_t bytes)
 {
 #ifdef DEBUG_SERIAL
@@ -2,6 +2,11 @@
 
 #include <Stream.h>
 
+#include "FrameCodec.h"
+#include "FrameParser.h"
+#include "Histogram.h"
+#include "StatusFrame.h"
+
 // To enable debug output uncomment one of the below lines
 // #define DEBUG_SERIAL Serial
 // #define DEBUG_SERIAL Serial1
@@ -73,6 +78,9 @@ namespace LC12S
         bool operator!=(const Settings& rhs) const { return !operator==(rhs); }
     };
 
+    /// @brief Convert a baudrate setting to bits per second
+    constexpr uint32_t baudrateToBps(const Baudrate baudrate) { return 600UL << baudrate; }
+
     constexpr const Settings DEFAULT_SETTINGS = {
         .moduleID = 0x58AF,
         .networkID = 0x0000,
@@ -109,6 +117,22 @@ public:
         float acPower; /// AC power in Watts
     };
 
+    /// @brief Link quality counters, always collected regardless of debug output
+    struct LinkStatistics
+    {
+        uint32_t bytesOut; /// Bytes written to the RF module
+        uint32_t bytesIn; /// Bytes read from the RF module
+        uint32_t requests; /// Requests sent to inverters
+        uint32_t replies; /// Replies matched to a request
+        uint32_t timeouts; /// Requests without reply within timeout
+        uint32_t crcErrors; /// Frames dropped due to checksum mismatch
+        uint32_t discardedBytes; /// Bytes dropped by the frame parser while resyncing
+        uint32_t callbacks; /// Status and command callbacks invoked
+        uint32_t callbackMaxMicros; /// Longest callback execution time in microseconds
+        NETSGP::Histogram<uint32_t> replyLatencyMS; /// Reply latency in milliseconds
+        NETSGP::Histogram<uint32_t> callbackMicros; /// Callback execution time in microseconds
+    };
+
     /// @brief All possible power grades from 0% up to 100%
     enum PowerGrade
     {
@@ -215,6 +239,25 @@ public:
         PG100,
     };
 
+    /// @brief All known commands
+    enum Command
+    {
+        STATUS = 0xC0, /// Get status command (0xC0)
+        CONTROL = 0xC1, /// Control command (0xC1)
+        POWER_GRADE = 0xC3, /// Set power grade command (0xC3)
+    };
+
+    /// @brief All known control values
+    enum Control
+    {
+        ACTIVATE = 0x01, /// Activate inverter
+        DEACTIVATE = 0x02, /// Deactivate inverter
+        REBOOT = 0x03, /// Reboot inverter
+    };
+
+    /// @brief Reconfigures the host UART connected to the RF module, e.g. with Serial2.updateBaudRate(bps)
+    typedef void (*HostBaudrateCallback)(const uint32_t bps);
+
 public:
     /// @brief Construct a new NETSGPClient object.
     ///
@@ -255,7 +298,21 @@ public:
     /// @return false if not
     bool reboot(const uint32_t deviceID);
 
+    /// @brief Get the link statistics collected since construction or the last resetStatistics()
+    LinkStatistics getStatistics() const;
+
+    /// @brief Reset all link statistics
+    void resetStatistics();
+
+    /// @brief Convert a compact status into an InverterStatus
+    ///
+    /// @param compact Compact status to convert
+    /// @return InverterStatus Valid status with all values in floating point
+    static InverterStatus toInverterStatus(const NETSGP::CompactStatus& compact);
+
     /// @brief Read the settings of the RF module
+    ///
+    /// This function blocks for about 400ms, see getCachedRFModuleSettings() to avoid that
     LC12S::Settings readRFModuleSettings();
 
     /// @brief Change the settings of the RF module to the provided ones.
@@ -265,30 +322,53 @@ public:
     /// @return false If not
     bool writeRFModuleSettings(const LC12S::Settings& settings);
 
+    /// @brief Change the settings of the RF module to the provided ones if needed.
+    ///
+    /// If the cached settings already match nothing is done. Otherwise programming mode is entered once to read the
+    /// settings and, if they mismatch, write the provided ones. The moduleID of the module is kept.
+    /// @param settings Settings the RF module should have
+    /// @return true If settings are correct or written successfully
+    /// @return false If settings could not be read or written
+    bool applyRFModuleSettings(const LC12S::Settings& settings);
+
     /// @brief Set the RF module to its default settings if needed.
     ///
     /// This function will read the RF module settings and then compare these with the default ones and if they
-    /// mismatch will write the default config
+    /// mismatch will write the default config, see applyRFModuleSettings()
     /// @return true If settings are correct or written successfully
     /// @return false If settings could not be written
     bool setDefaultRFSettings();
 
-protected:
-    /// @brief All known commands
-    enum Command
-    {
-        STATUS = 0xC0, /// Get status command (0xC0)
-        CONTROL = 0xC1, /// Control command (0xC1)
-        POWER_GRADE = 0xC3, /// Set power grade command (0xC3)
-    };
+    /// @brief Get the RF module settings last read from or written to the module without accessing it
+    ///
+    /// @return const LC12S::Settings& Cached settings, valid is false if the module was never accessed
+    const LC12S::Settings& getCachedRFModuleSettings() const { return mModuleSettings; }
 
-    /// @brief All known control values
-    enum Control
-    {
-        ACTIVATE = 0x01, /// Activate inverter
-        DEACTIVATE = 0x02, /// Deactivate inverter
-        REBOOT = 0x03, /// Reboot inverter
-    };
+    /// @brief Raise the baudrate of the RF module and the host UART as far as the link allows.
+    ///
+    /// Starting at maxBaudrate every baudrate above the current one is written to the RF module, the host UART is
+    /// switched with setHostBaudrate and the link is verified by reading the module settings back and by a status
+    /// request to probeDeviceID. If verification fails, the previous baudrate is restored on both sides and the next
+    /// lower baudrate is tried. The module keeps the result across power cycles, so use detectBaudrate() after a
+    /// restart. setDefaultRFSettings() switches the module back to 9600 baud, so call it before and not after.
+    /// This function blocks for about one second per tried baudrate.
+    /// @param setHostBaudrate Callback reconfiguring the host UART
+    /// @param probeDeviceID Inverter that has to reply at the new baudrate, 0 to only verify the RF module
+    /// @param baudrate Baudrate in effect afterwards
+    /// @param maxBaudrate Highest baudrate to try
+    /// @return true If the RF module answers at baudrate
+    /// @return false If the RF module did not answer at the current baudrate in the first place
+    bool negotiateBaudrate(HostBaudrateCallback setHostBaudrate, const uint32_t probeDeviceID,
+        LC12S::Baudrate& baudrate, const LC12S::Baudrate maxBaudrate = LC12S::BPS_38400);
+
+    /// @brief Find the baudrate the RF module is configured to by reading its settings at every baudrate.
+    ///
+    /// The host UART stays at the found baudrate.
+    /// @param setHostBaudrate Callback reconfiguring the host UART
+    /// @param baudrate Found baudrate
+    /// @return true If the RF module answered
+    /// @return false If the RF module did not answer at any baudrate
+    bool detectBaudrate(HostBaudrateCallback setHostBaudrate, LC12S::Baudrate& baudrate);
 
 protected:
     /// @brief Send a specific command to a specific inverter with a specific value.
@@ -307,28 +387,54 @@ protected:
     /// @return false not
     bool sendCommandAndValidate(const uint32_t deviceID, const Command command, const uint8_t value = 0x00);
 
-    /// @brief Wait for a message with a timeout of 1 second
+    /// @brief Wait for a reply with a timeout of 1 second
     ///
-    /// @return true If stream contains a message within timeout
+    /// @param command Expected command of reply
+    /// @return true If a reply was received within timeout and read into mBuffer
     /// @return false If not
-    bool waitForMessage();
+    bool waitForReply(const Command command);
 
-    /// @brief Try to find a reply in the stream and if present read it into mBuffer
+    /// @brief Feed all available bytes into the frame parser and if a reply is complete read it into mBuffer.
     ///
-    /// @param command Expected command of reply
+    /// This function never blocks, partially received replies are kept until the next call.
+    /// @param command Expected command of reply, replies with other commands are dropped
     /// @return true If reply was found and read into mBuffer
     /// @return false If not
     bool findAndReadReply(const Command command);
 
-    /// @brief Calculate the checksum for a message inside the buffer.
+    /// @brief Feed all available bytes into the frame parser and if any reply is complete read it into mBuffer.
+    ///
+    /// This function never blocks, partially received replies are kept until the next call.
+    /// @return true If a reply was read into mBuffer, mBuffer[1] contains its command
+    /// @return false If not
+    bool readReply();
+
+    /// @brief Build a RF module configuration frame in mConfigBuffer
     ///
-    /// @param bytes The amount of bytes to calculate the checksum for
-    /// @return uint8_t CRC
-    uint8_t calcCRC(const size_t bytes) const;
+    /// @param command CONFIG_READ or CONFIG_WRITE
+    /// @param settings Settings to write, unused for CONFIG_READ
+    void buildConfigFrame(const uint8_t command, const LC12S::Settings& settings);
+
+    /// @brief Parse the RF module reply in mConfigBuffer and update the cached settings
+    ///
+    /// @param command Command of the request the reply belongs to
+    /// @param settings Settings contained in the reply
+    /// @return true If the reply is valid
+    /// @return false If not
+    bool parseConfigReply(const uint8_t command, LC12S::Settings& settings);
+
+    /// @brief Send a configuration frame and read the reply, programming mode has to be enabled already
+    ///
+    /// @param command CONFIG_READ or CONFIG_WRITE
+    /// @param settings Settings to write, unused for CONFIG_READ
+    /// @param reply Settings contained in the reply
+    /// @return true If a valid reply was received
+    /// @return false If not
+    bool configTransaction(const uint8_t command, const LC12S::Settings& settings, LC12S::Settings& reply);
 
     /// @brief Enable programming mode of the RF module.
     ///
-    /// This function will delay code execution for 400ms
+    /// This function will delay code execution for PROGRAMMING_DELAY_MS
     void enableProgramming();
 
     /// @brief Disable programming mode of the RF module.
@@ -336,6 +442,17 @@ protected:
     /// This function will delay code execution for 10ms
     void disableProgramming();
 
+    /// @brief Check that the RF module answers at the given baudrate and an inverter replies through it
+    ///
+    /// @param baudrate Baudrate the RF module is expected to report
+    /// @param probeDeviceID Inverter that has to reply, 0 to skip
+    /// @return true If the link works
+    /// @return false If not
+    bool verifyLink(const LC12S::Baudrate baudrate, const uint32_t probeDeviceID);
+
+    /// @brief Drop all received bytes and any partially parsed reply, e.g. garbage after a baudrate change
+    void flushInput();
+
     /// @brief Fill the given inverter status from the given buffer
     ///
     /// @param buffer Bufffer containing raw inverter status data, must be at least 27 bytes in size
@@ -344,6 +461,26 @@ protected:
     /// @return false If checksum is invalid
     bool fillInverterStatusFromBuffer(const uint8_t* buffer, InverterStatus& status);
 
+    /// @brief Get the device identifier of a request or reply
+    ///
+    /// @param buffer Buffer containing a message, must be at least 10 bytes in size
+    /// @return uint32_t Device identifier
+    static uint32_t deviceIDFromBuffer(const uint8_t* buffer);
+
+    /// @brief Count a reply that was matched to its request
+    ///
+    /// @param latencyMS Time from sending the request to receiving the reply in milliseconds
+    void countReply(const uint32_t latencyMS)
+    {
+        ++mStatistics.replies;
+        mStatistics.replyLatencyMS.add(latencyMS);
+    }
+
+    /// @brief Count the execution time of a user callback
+    ///
+    /// @param startMicros Time in microseconds the callback was started at
+    void countCallback(const uint32_t startMicros);
+
     /// @brief Dump the buffer contents to debug serial
     ///
     /// @param bytes Amount of bytes to dump
@@ -351,8 +488,16 @@ protected:
 
 protected:
     constexpr static const size_t BUFFER_SIZE = 32;
-    constexpr static const uint8_t MAGIC_BYTE = 0x43; /// Magic byte indicating start of messages
+    constexpr static const uint8_t MAGIC_BYTE = NETSGP::FrameParser::MAGIC_BYTE; /// Magic byte indicating start of messages
     Stream& mStream; /// Stream for communication
     uint8_t mProgPin; /// Programming enable pin of RF module (active low)
+    constexpr static const size_t CONFIG_FRAME_SIZE = NETSGP::Codec::ConfigFrame::SIZE; /// Size of configuration frames
+    constexpr static const uint8_t CONFIG_READ = 0x5C; /// Read settings command of the RF module
+    constexpr static const uint8_t CONFIG_WRITE = 0x5A; /// Write settings command of the RF module
+    constexpr static const uint16_t PROGRAMMING_DELAY_MS = 400; /// Time the RF module needs to enter programming mode
     uint8_t mBuffer[BUFFER_SIZE] = {0}; /// Inernal buffer
+    uint8_t mConfigBuffer[CONFIG_FRAME_SIZE] = {0}; /// RF module configuration frames, separate from async replies
+    LC12S::Settings mModuleSettings = {}; /// Settings last read from or written to the RF module
+    NETSGP::FrameParser mParser; /// Incremental parser for replies
+    LinkStatistics mStatistics = {}; /// Link statistics, parser counters are merged in getStatistics()
 };
@@ -0,0 +1,170 @@
+#include "RadioWorker.h"
+
+#include <Arduino.h>
+
+RadioWorker::RadioWorker(AsyncNETSGPClientBase& client, const uint32_t statusTimeoutMS)
+    : mClient(client), mListening(client.addStatusListener(*this)), mStatusTimeoutMS(statusTimeoutMS)
+{
+    mClient.setCommandListener(this);
+}
+
+RadioWorker::~RadioWorker()
+{
+    mClient.removeStatusListener(*this);
+    mClient.setCommandListener(nullptr);
+}
+
+bool RadioWorker::attach(Channel& channel)
+{
+    // Status requests could never complete, try again in case a slot became free
+    mListening = mListening || mClient.addStatusListener(*this);
+    if (!mListening)
+    {
+        DEBUGLN("[RadioWorker] No free status listener slot");
+        return false;
+    }
+    for (Channel*& slot : mChannels)
+    {
+        if (slot == &channel)
+        {
+            return true;
+        }
+        if (!slot)
+        {
+            slot = &channel;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RadioWorker::step()
+{
+    size_t freeSlot = 0;
+    for (uint8_t i = 0; i < MAX_CHANNELS && mChannels[i]; ++i)
+    {
+        WorkerRequest* request;
+        while ((request = mChannels[i]->mRequests.front()) != nullptr)
+        {
+            while (freeSlot < MAX_PENDING && mPending[freeSlot].used)
+            {
+                ++freeSlot;
+            }
+            if (freeSlot >= MAX_PENDING || !dispatch(i, *request, mPending[freeSlot]))
+            {
+                break;
+            }
+            mChannels[i]->mRequests.pop();
+        }
+    }
+
+    mClient.update();
+
+    const uint32_t currentMillis = millis();
+    for (Pending& slot : mPending)
+    {
+        if (slot.used && slot.request.type == REQUEST_STATUS && currentMillis - slot.startMS >= mStatusTimeoutMS)
+        {
+            finish(slot, false, nullptr);
+        }
+    }
+}
+
+size_t RadioWorker::pending() const
+{
+    size_t count = 0;
+    for (const Pending& slot : mPending)
+    {
+        count += slot.used;
+    }
+    return count;
+}
+
+void RadioWorker::onStatus(const NETSGP::CompactStatus& status, const uint32_t)
+{
+    for (Pending& slot : mPending)
+    {
+        if (slot.used && slot.request.type == REQUEST_STATUS && slot.request.deviceID == status.deviceID)
+        {
+            finish(slot, true, &status);
+        }
+    }
+}
+
+void RadioWorker::onCommand(const AsyncNETSGPClientBase::CommandResult& result)
+{
+    for (Pending& slot : mPending)
+    {
+        // Equal requests to the same inverter are interchangeable, so the first match is good enough
+        if (slot.used && slot.request.type != REQUEST_STATUS && slot.request.deviceID == result.deviceID
+            && slot.command == result.command && slot.value == result.value)
+        {
+            finish(slot, result.outcome == AsyncNETSGPClientBase::COMMAND_SUCCESS, nullptr);
+            return;
+        }
+    }
+}
+
+bool RadioWorker::dispatch(const uint8_t channel, const WorkerRequest& request, Pending& slot)
+{
+    slot.channel = channel;
+    slot.request = request;
+    slot.startMS = millis();
+    slot.value = request.value;
+    slot.command = NETSGPClient::Command::CONTROL;
+
+    bool queued;
+    switch (request.type)
+    {
+    case REQUEST_STATUS:
+        slot.command = NETSGPClient::Command::STATUS;
+        slot.used = true;
+        if (!mClient.registerInverter(request.deviceID))
+        {
+            finish(slot, false, nullptr);
+        }
+        return true;
+    case REQUEST_POWER_GRADE:
+        slot.command = NETSGPClient::Command::POWER_GRADE;
+        queued = mClient.setPowerGradeAsync(request.deviceID, static_cast<NETSGPClient::PowerGrade>(request.value));
+        break;
+    case REQUEST_ACTIVATE:
+    case REQUEST_DEACTIVATE:
+        slot.value = request.type == REQUEST_ACTIVATE ? NETSGPClient::Control::ACTIVATE
+                                                      : NETSGPClient::Control::DEACTIVATE;
+        queued = mClient.activateAsync(request.deviceID, request.type == REQUEST_ACTIVATE);
+        break;
+    case REQUEST_REBOOT:
+        slot.value = NETSGPClient::Control::REBOOT;
+        queued = mClient.rebootAsync(request.deviceID);
+        break;
+    default:
+        slot.used = true;
+        finish(slot, false, nullptr);
+        return true;
+    }
+    // A full command queue is not an error, the request stays in its channel until the queue drains
+    slot.used = queued;
+    return queued;
+}
+
+void RadioWorker::finish(Pending& slot, const bool success, const NETSGP::CompactStatus* status)
+{
+    WorkerResult result;
+    result.request = slot.request;
+    result.success = success;
+    if (status)
+    {
+        result.status = NETSGPClient::toInverterStatus(*status);
+    }
+    else
+    {
+        result.status = {};
+        result.status.deviceID = slot.request.deviceID;
+        result.status.valid = false;
+    }
+    result.latencyMS = millis() - slot.startMS;
+    slot.used = false;
+    // Never fails, a channel never has more than CHANNEL_DEPTH requests outstanding
+    mChannels[slot.channel]->mResults.push(result);
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "AsyncNETSGPClient.h"
+#include "SpscQueue.h"
+
+/// @brief Runs an AsyncNETSGPClient on a dedicated radio task and serves requests of other tasks.
+///
+/// The worker is the only one touching the client and its Stream, so the shared buffers of the client are never used
+/// concurrently. Every consumer task gets its own Channel with a lock-free request queue and a lock-free result queue,
+/// nothing blocks and no mutex is involved. Call step() in a loop on the radio task, e.g. a FreeRTOS task pinned to
+/// one core of an ESP32, and Channel::submit() and Channel::poll() from the consumer task owning the channel.
+class RadioWorker : public NETSGP::StatusListener, public AsyncNETSGPClientBase::CommandListener
+{
+public:
+    /// @brief Kinds of requests a consumer can submit
+    enum RequestType
+    {
+        REQUEST_STATUS, /// Get the next status of the inverter, registers it for polling if needed
+        REQUEST_POWER_GRADE, /// Set the power grade given as value
+        REQUEST_ACTIVATE, /// Activate the inverter
+        REQUEST_DEACTIVATE, /// Deactivate the inverter
+        REQUEST_REBOOT, /// Reboot the inverter
+    };
+
+    /// @brief A request of a consumer
+    struct WorkerRequest
+    {
+        RequestType type; /// Kind of request
+        uint32_t deviceID; /// Unique inverter identifier
+        uint8_t value; /// Power grade for REQUEST_POWER_GRADE, unused otherwise
+        uint32_t tag; /// Arbitrary value of the consumer, returned with the result
+    };
+
+    /// @brief Result of a request
+    struct WorkerResult
+    {
+        WorkerRequest request; /// The request
+        bool success; /// Was the request successful
+        NETSGPClient::InverterStatus status; /// Received status for REQUEST_STATUS, status.valid tells success
+        uint32_t latencyMS; /// Time from taking the request to its result in milliseconds
+    };
+
+    constexpr static const size_t CHANNEL_DEPTH = 16; /// Maximum amount of outstanding requests per channel
+    constexpr static const size_t MAX_CHANNELS = 4; /// Maximum amount of channels
+    constexpr static const size_t MAX_PENDING = 32; /// Maximum amount of requests handed to the client at once
+
+    /// @brief Request and result queues between one consumer task and the worker
+    class Channel
+    {
+    public:
+        /// @brief Submit a request, consumer task only
+        ///
+        /// @return true If the request was submitted
+        /// @return false If CHANNEL_DEPTH requests are outstanding, poll() results first
+        bool submit(const WorkerRequest& request)
+        {
+            if (mOutstanding >= CHANNEL_DEPTH || !mRequests.push(request))
+            {
+                return false;
+            }
+            ++mOutstanding;
+            return true;
+        }
+
+        /// @brief Get the next result, consumer task only
+        ///
+        /// @return true If a result was copied
+        /// @return false If no result is available
+        bool poll(WorkerResult& result)
+        {
+            if (!mResults.tryPop(result))
+            {
+                return false;
+            }
+            --mOutstanding;
+            return true;
+        }
+
+        /// @brief Get the amount of submitted requests without result, consumer task only
+        size_t outstanding() const { return mOutstanding; }
+
+    private:
+        friend class RadioWorker;
+
+        NETSGP::SpscQueue<WorkerRequest, CHANNEL_DEPTH> mRequests; /// Consumer to worker
+        NETSGP::SpscQueue<WorkerResult, CHANNEL_DEPTH> mResults; /// Worker to consumer, never overflows
+        size_t mOutstanding = 0; /// Requests without result, only touched by the consumer
+    };
+
+public:
+    /// @brief Construct a new RadioWorker object and take over the client's status listener slot and command listener
+    ///
+    /// @param client Client to run, must only be used through this worker afterwards
+    /// @param statusTimeoutMS Fail status requests without status within this time in milliseconds
+    RadioWorker(AsyncNETSGPClientBase& client, const uint32_t statusTimeoutMS = 5000);
+
+    /// @brief Remove the worker from the status listeners and as command listener of the client
+    ~RadioWorker();
+
+    RadioWorker(const RadioWorker&) = delete;
+    RadioWorker& operator=(const RadioWorker&) = delete;
+
+    /// @brief Attach a consumer channel, only before the worker task is started
+    ///
+    /// @return true If the channel was attached
+    /// @return false If MAX_CHANNELS are already attached or the worker is no status listener of the client because
+    /// all MAX_STATUS_LISTENERS slots are taken
+    bool attach(Channel& channel);
+
+    /// @brief Take new requests, update the client and deliver results, radio task only
+    void step();
+
+    /// @brief Get the amount of requests handed to the client and waiting for their result, radio task only
+    size_t pending() const;
+
+    void onStatus(const NETSGP::CompactStatus& status, const uint32_t timeMS) override;
+    void onCommand(const AsyncNETSGPClientBase::CommandResult& result) override;
+
+private:
+    /// @brief A request handed to the client
+    struct Pending
+    {
+        bool used; /// Is this slot in use
+        uint8_t channel; /// Index of the channel the request came from
+        uint8_t command; /// Command sent for the request
+        uint8_t value; /// Value sent for the request
+        uint32_t startMS; /// Time the request was taken
+        WorkerRequest request; /// The request
+    };
+
+    /// @brief Hand a request to the client
+    ///
+    /// @return true If the client took the request or it failed right away
+    /// @return false If the client can not take it now, try again later
+    bool dispatch(const uint8_t channel, const WorkerRequest& request, Pending& slot);
+
+    /// @brief Deliver the result of a pending request and free its slot
+    void finish(Pending& slot, const bool success, const NETSGP::CompactStatus* status);
+
+private:
+    AsyncNETSGPClientBase& mClient; /// Client owned by the radio task
+    bool mListening; /// Is the worker a status listener of the client
+    uint32_t mStatusTimeoutMS; /// Timeout of status requests
+    Channel* mChannels[MAX_CHANNELS] = {}; /// Attached channels
+    Pending mPending[MAX_PENDING] = {}; /// Requests handed to the client
+};
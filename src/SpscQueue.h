@@ -0,0 +1,77 @@
+#pragma once
+
+#include "ByteRing.h"
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Lock-free single producer single consumer queue of trivially copyable elements
+    ///
+    /// One thread (or interrupt) only calls push(), another one only calls front(), pop() and tryPop().
+    /// @tparam T Element type
+    /// @tparam Capacity Maximum amount of elements, must be a power of two
+    template <typename T, size_t Capacity>
+    class SpscQueue
+    {
+        typedef RingIndex::Value Index;
+
+        static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+        static_assert(Capacity < (static_cast<uint64_t>(1) << (8 * sizeof(Index))), "Capacity too large for Index");
+
+    public:
+        /// @brief Append an element, producer side only
+        ///
+        /// @return true If the element was appended
+        /// @return false If the queue is full
+        bool push(const T& element)
+        {
+            const Index head = mHead.loadRelaxed();
+            if (static_cast<Index>(head - mTail.loadAcquire()) >= Capacity)
+            {
+                return false;
+            }
+            mElements[head & (Capacity - 1)] = element;
+            mHead.storeRelease(head + 1);
+            return true;
+        }
+
+        /// @brief Get the oldest element without removing it, consumer side only
+        ///
+        /// @return T* Oldest element or nullptr if the queue is empty
+        T* front()
+        {
+            const Index tail = mTail.loadRelaxed();
+            return mHead.loadAcquire() == tail ? nullptr : &mElements[tail & (Capacity - 1)];
+        }
+
+        /// @brief Remove the oldest element, consumer side only and only after front() returned one
+        void pop() { mTail.storeRelease(mTail.loadRelaxed() + 1); }
+
+        /// @brief Remove the oldest element and copy it, consumer side only
+        ///
+        /// @return true If an element was removed
+        /// @return false If the queue is empty
+        bool tryPop(T& element)
+        {
+            T* oldest = front();
+            if (!oldest)
+            {
+                return false;
+            }
+            element = *oldest;
+            pop();
+            return true;
+        }
+
+        /// @brief Get the amount of elements, exact on the consumer side, a lower bound on the producer side
+        size_t size() const { return static_cast<Index>(mHead.loadAcquire() - mTail.loadAcquire()); }
+
+        /// @brief Is the queue empty
+        bool empty() const { return size() == 0; }
+
+    private:
+        T mElements[Capacity]; /// Element storage
+        RingIndex mHead; /// Index the next element is pushed to, written by the producer only
+        RingIndex mTail; /// Index the next element is popped from, written by the consumer only
+    };
+} // namespace NETSGP
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "FrameCodec.h"
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Compact fixed point inverter status holding the values as transmitted (20 bytes)
+    ///
+    /// No floating point math is needed to create or compare it, the float accessors convert on demand.
+    struct CompactStatus
+    {
+        uint32_t deviceID; /// Unique inverter identifier
+        uint32_t totalGeneratedPowerBits; /// IEEE 754 bits of the total generated power (kWh? not reversed)
+        uint16_t dcVoltage; /// DC voltage in centivolts (panel voltage)
+        uint16_t dcCurrent; /// DC current in centiamperes (panel current)
+        uint16_t acVoltage; /// AC voltage in centivolts
+        uint16_t acCurrent; /// AC current in centiamperes
+        uint8_t state; /// Inverter state (not reversed)
+        uint8_t temperature; /// Inverter temperature (not reversed)
+
+        /// @brief DC power in 1/10000 Watts
+        uint32_t dcPowerRaw() const { return static_cast<uint32_t>(dcVoltage) * dcCurrent; }
+
+        /// @brief AC power in 1/10000 Watts
+        uint32_t acPowerRaw() const { return static_cast<uint32_t>(acVoltage) * acCurrent; }
+
+        /// @brief Total generated power as float
+        float totalGeneratedPower() const
+        {
+            float value;
+            memcpy(&value, &totalGeneratedPowerBits, sizeof(value));
+            return value;
+        }
+
+        float dcVoltageV() const { return dcVoltage / 100.0f; }
+        float dcCurrentA() const { return dcCurrent / 100.0f; }
+        float dcPowerW() const { return dcVoltageV() * dcCurrentA(); }
+        float acVoltageV() const { return acVoltage / 100.0f; }
+        float acCurrentA() const { return acCurrent / 100.0f; }
+        float acPowerW() const { return acVoltageV() * acCurrentA(); }
+    };
+
+    /// @brief Zero copy view over a raw 27 byte STATUS reply, see Codec::StatusReply
+    class StatusFrame
+    {
+    public:
+        constexpr static const size_t SIZE = Codec::StatusReply::SIZE; /// Size of a STATUS reply in bytes
+
+    public:
+        /// @brief Construct a view over a raw frame
+        ///
+        /// @param frame Raw STATUS reply, must be at least SIZE bytes and outlive the view
+        explicit StatusFrame(const uint8_t* frame) : mFrame(frame) { }
+
+        /// @brief Check the checksum over the first 14 bytes
+        bool valid() const { return Codec::StatusReply::valid(mFrame); }
+
+        uint32_t deviceID() const { return Codec::StatusReply::DeviceID::read(mFrame); }
+        uint32_t totalGeneratedPowerBits() const { return Codec::StatusReply::TotalGeneratedPower::read(mFrame); }
+        uint16_t dcVoltage() const { return Codec::StatusReply::DCVoltage::read(mFrame); }
+        uint16_t dcCurrent() const { return Codec::StatusReply::DCCurrent::read(mFrame); }
+        uint16_t acVoltage() const { return Codec::StatusReply::ACVoltage::read(mFrame); }
+        uint16_t acCurrent() const { return Codec::StatusReply::ACCurrent::read(mFrame); }
+        uint8_t state() const { return Codec::StatusReply::State::read(mFrame); }
+        uint8_t temperature() const { return Codec::StatusReply::Temperature::read(mFrame); }
+
+        /// @brief Decode into a compact status without any floating point math
+        CompactStatus compact() const
+        {
+            CompactStatus status;
+            status.deviceID = deviceID();
+            status.totalGeneratedPowerBits = totalGeneratedPowerBits();
+            status.dcVoltage = dcVoltage();
+            status.dcCurrent = dcCurrent();
+            status.acVoltage = acVoltage();
+            status.acCurrent = acCurrent();
+            status.state = state();
+            status.temperature = temperature();
+            return status;
+        }
+
+        /// @brief Encode a compact status into a raw STATUS reply as an inverter would send it
+        ///
+        /// @param status Status to encode
+        /// @param frame Destination, at least SIZE bytes
+        static void encode(const CompactStatus& status, uint8_t* frame)
+        {
+            typedef Codec::StatusReply Reply;
+            memset(frame, 0, SIZE);
+            Reply::Magic::write(frame, Codec::CommandFrame::MAGIC);
+            Reply::Command::write(frame, STATUS_COMMAND);
+            Reply::DeviceID::write(frame, status.deviceID);
+            Reply::TotalGeneratedPower::write(frame, status.totalGeneratedPowerBits);
+            Reply::Checksum::write(frame,
+                Codec::CommandFrame::CONSTANT_SUM + Reply::Command::sum(STATUS_COMMAND)
+                    + Reply::DeviceID::sum(status.deviceID)
+                    + Reply::TotalGeneratedPower::sum(status.totalGeneratedPowerBits));
+            Reply::DCVoltage::write(frame, status.dcVoltage);
+            Reply::DCCurrent::write(frame, status.dcCurrent);
+            Reply::ACVoltage::write(frame, status.acVoltage);
+            Reply::ACCurrent::write(frame, status.acCurrent);
+            Reply::State::write(frame, status.state);
+            Reply::Temperature::write(frame, status.temperature);
+        }
+
+    private:
+        constexpr static const uint8_t STATUS_COMMAND = 0xC0; /// Command byte of STATUS
+
+    private:
+        const uint8_t* mFrame; /// Raw frame
+    };
+
+    /// @brief Fixed size ring of compact statuses with their receive time, oldest entries get overwritten
+    ///
+    /// @tparam Capacity Maximum amount of entries
+    template <size_t Capacity>
+    class StatusRing
+    {
+        static_assert(Capacity > 0, "StatusRing needs capacity");
+
+    public:
+        /// @brief A status and the time it was received
+        struct Entry
+        {
+            uint32_t timeMS; /// Receive time in milliseconds
+            CompactStatus status; /// Received status
+        };
+
+    public:
+        /// @brief Add a status, overwriting the oldest one if full
+        void push(const CompactStatus& status, const uint32_t timeMS)
+        {
+            mEntries[mHead] = {timeMS, status};
+            mHead = (mHead + 1) % Capacity;
+            if (mSize < Capacity)
+            {
+                ++mSize;
+            }
+        }
+
+        /// @brief Get the amount of stored entries
+        size_t size() const { return mSize; }
+
+        /// @brief Get an entry, 0 is the oldest one
+        const Entry& operator[](const size_t index) const
+        {
+            return mEntries[(mHead + Capacity - mSize + index) % Capacity];
+        }
+
+        /// @brief Remove all entries
+        void clear()
+        {
+            mHead = 0;
+            mSize = 0;
+        }
+
+    private:
+        Entry mEntries[Capacity]; /// Entry storage
+        size_t mHead = 0; /// Index the next entry gets written to
+        size_t mSize = 0; /// Amount of stored entries
+    };
+} // namespace NETSGP
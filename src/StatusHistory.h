@@ -0,0 +1,446 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "StatusListener.h"
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Minimum, average and maximum of a value
+    struct ValueStats
+    {
+        uint16_t min;
+        uint16_t avg;
+        uint16_t max;
+    };
+
+    /// @brief A single sample or a downsampled bucket of an inverter history
+    struct HistoryPoint
+    {
+        uint32_t timeS; /// Sample time or bucket start in seconds since the history received its first status
+        uint16_t samples; /// Amount of raw samples, 0 for buckets without data
+        ValueStats acPower; /// AC power in deciwatts
+        ValueStats dcVoltage; /// DC voltage in centivolts
+        ValueStats dcCurrent; /// DC current in centiamperes
+        ValueStats temperature; /// Temperature (not reversed)
+    };
+
+    /// @brief Resolution tiers of a StatusHistory
+    enum HistoryTier
+    {
+        TIER_RAW, /// Every received status
+        TIER_MINUTE, /// One minute buckets
+        TIER_QUARTER, /// Fifteen minute buckets
+    };
+
+    /// @brief Fixed memory time series store of inverter statuses with tiered downsampling.
+    ///
+    /// Add it as status listener to an AsyncNETSGPClient. Every inverter gets its own series holding the last
+    /// RawSamples statuses, MinuteBuckets one minute buckets and QuarterBuckets fifteen minute buckets with minimum,
+    /// average and maximum of AC power, DC voltage, DC current and temperature. Values are stored in fixed point,
+    /// raw sample times as deltas and bucket times are implied by their position. The defaults keep 24 hours of
+    /// fifteen minute buckets. Memory use is exactly MaxInverters * BYTES_PER_INVERTER plus a few bytes.
+    /// @tparam MaxInverters Maximum amount of inverters, statuses of further inverters are ignored
+    /// @tparam RawSamples Amount of raw samples per inverter
+    /// @tparam MinuteBuckets Amount of one minute buckets per inverter
+    /// @tparam QuarterBuckets Amount of fifteen minute buckets per inverter
+    template <size_t MaxInverters, size_t RawSamples = 30, size_t MinuteBuckets = 60, size_t QuarterBuckets = 96>
+    class StatusHistory : public StatusListener
+    {
+        static_assert(RawSamples > 0 && MinuteBuckets > 0 && QuarterBuckets > 0, "Every tier needs capacity");
+
+        constexpr static const size_t VALUES = 4; /// AC power, DC voltage, DC current, temperature
+
+        /// @brief A raw sample with its time relative to the previous sample
+        struct RawSample
+        {
+            uint16_t deltaS; /// Seconds since the previous sample
+            uint16_t values[VALUES]; /// Sample values
+        };
+
+        /// @brief Minimum, average and maximum of all values over a bucket
+        struct Bucket
+        {
+            uint16_t samples; /// Amount of raw samples
+            uint16_t min[VALUES]; /// Minimum values
+            uint16_t avg[VALUES]; /// Average values
+            uint16_t max[VALUES]; /// Maximum values
+        };
+
+        /// @brief Fixed size ring overwriting the oldest entry
+        template <typename T, size_t N>
+        struct Ring
+        {
+            T entries[N];
+            uint16_t head; /// Index the next entry gets written to
+            uint16_t size; /// Amount of stored entries
+
+            void push(const T& entry)
+            {
+                entries[head] = entry;
+                head = (head + 1) % N;
+                if (size < N)
+                {
+                    ++size;
+                }
+            }
+
+            /// @brief Get an entry, 0 is the oldest one
+            const T& at(const size_t index) const { return entries[(head + N - size + index) % N]; }
+        };
+
+        /// @brief Running aggregate of the bucket currently being filled
+        struct Accumulator
+        {
+            uint32_t index; /// Bucket index (time / period)
+            uint16_t samples; /// Amount of added samples
+            uint32_t sum[VALUES]; /// Sums of all values
+            uint16_t min[VALUES]; /// Minimum values
+            uint16_t max[VALUES]; /// Maximum values
+
+            void add(const uint16_t* values)
+            {
+                for (size_t i = 0; i < VALUES; ++i)
+                {
+                    sum[i] = samples ? sum[i] + values[i] : values[i];
+                    min[i] = samples && min[i] < values[i] ? min[i] : values[i];
+                    max[i] = samples && max[i] > values[i] ? max[i] : values[i];
+                }
+                ++samples;
+            }
+
+            Bucket bucket() const
+            {
+                Bucket bucket;
+                bucket.samples = samples;
+                for (size_t i = 0; i < VALUES; ++i)
+                {
+                    bucket.min[i] = min[i];
+                    bucket.avg[i] = samples ? (sum[i] + samples / 2) / samples : 0;
+                    bucket.max[i] = max[i];
+                }
+                return bucket;
+            }
+        };
+
+        /// @brief A downsampled tier
+        template <size_t N>
+        struct Tier
+        {
+            Ring<Bucket, N> ring; /// Closed buckets
+            uint32_t newest; /// Bucket index of the newest closed bucket
+            Accumulator open; /// Bucket being filled
+
+            void add(const uint32_t index, const uint16_t* values)
+            {
+                if (open.samples && open.index != index)
+                {
+                    if (ring.size)
+                    {
+                        // Keep bucket times implied by their position, gaps get empty buckets
+                        const uint32_t gap = open.index - newest - 1;
+                        const Bucket empty = {};
+                        for (uint32_t i = 0; i < gap && i < N; ++i)
+                        {
+                            ring.push(empty);
+                        }
+                    }
+                    ring.push(open.bucket());
+                    newest = open.index;
+                    open.samples = 0;
+                }
+                open.index = index;
+                open.add(values);
+            }
+        };
+
+        /// @brief History of a single inverter
+        struct Series
+        {
+            uint32_t deviceID; /// Unique inverter identifier
+            bool used; /// Is this series assigned to an inverter
+            uint32_t rawNewestS; /// Time of the newest raw sample
+            Ring<RawSample, RawSamples> raw; /// Raw samples
+            Tier<MinuteBuckets> minute; /// One minute buckets
+            Tier<QuarterBuckets> quarter; /// Fifteen minute buckets
+        };
+
+    public:
+        constexpr static const size_t BYTES_PER_INVERTER = sizeof(Series); /// Memory used per inverter
+
+        /// @brief Iterator over the points of a range query
+        class Iterator
+        {
+        public:
+            Iterator(const Series* series, const HistoryTier tier, const size_t index, const uint32_t timeS)
+                : mSeries(series), mTier(tier), mIndex(index), mTimeS(timeS)
+            { }
+
+            HistoryPoint operator*() const
+            {
+                HistoryPoint point;
+                point.timeS = mTimeS;
+                if (mTier == TIER_RAW)
+                {
+                    const RawSample& sample = mSeries->raw.at(mIndex);
+                    point.samples = 1;
+                    fill(point, sample.values, sample.values, sample.values);
+                }
+                else
+                {
+                    const Bucket bucket = this->bucket();
+                    point.samples = bucket.samples;
+                    fill(point, bucket.min, bucket.avg, bucket.max);
+                }
+                return point;
+            }
+
+            Iterator& operator++()
+            {
+                ++mIndex;
+                if (mTier == TIER_RAW)
+                {
+                    if (mIndex < mSeries->raw.size)
+                    {
+                        mTimeS += mSeries->raw.at(mIndex).deltaS;
+                    }
+                }
+                else if (mIndex == closedBuckets())
+                {
+                    // The open bucket does not have to follow the newest closed bucket directly, e.g. after an outage
+                    mTimeS = openIndex() * periodS(mTier);
+                }
+                else
+                {
+                    mTimeS += periodS(mTier);
+                }
+                return *this;
+            }
+
+            bool operator==(const Iterator& rhs) const { return mIndex == rhs.mIndex; }
+            bool operator!=(const Iterator& rhs) const { return mIndex != rhs.mIndex; }
+
+        private:
+            size_t closedBuckets() const
+            {
+                return mTier == TIER_MINUTE ? mSeries->minute.ring.size : mSeries->quarter.ring.size;
+            }
+
+            uint32_t openIndex() const
+            {
+                return mTier == TIER_MINUTE ? mSeries->minute.open.index : mSeries->quarter.open.index;
+            }
+
+            Bucket bucket() const
+            {
+                if (mTier == TIER_MINUTE)
+                {
+                    return mIndex < mSeries->minute.ring.size ? mSeries->minute.ring.at(mIndex)
+                                                              : mSeries->minute.open.bucket();
+                }
+                return mIndex < mSeries->quarter.ring.size ? mSeries->quarter.ring.at(mIndex)
+                                                           : mSeries->quarter.open.bucket();
+            }
+
+            static void fill(HistoryPoint& point, const uint16_t* min, const uint16_t* avg, const uint16_t* max)
+            {
+                ValueStats* stats[VALUES] = {&point.acPower, &point.dcVoltage, &point.dcCurrent, &point.temperature};
+                for (size_t i = 0; i < VALUES; ++i)
+                {
+                    *stats[i] = {min[i], avg[i], max[i]};
+                }
+            }
+
+        private:
+            const Series* mSeries; /// Series to iterate
+            HistoryTier mTier; /// Tier to iterate
+            size_t mIndex; /// Current entry, the open bucket follows the closed ones
+            uint32_t mTimeS; /// Time of the current entry
+        };
+
+        /// @brief Result of a range query usable in range based for loops
+        class Range
+        {
+        public:
+            Range(const Iterator& begin, const Iterator& end) : mBegin(begin), mEnd(end) { }
+            Iterator begin() const { return mBegin; }
+            Iterator end() const { return mEnd; }
+
+        private:
+            Iterator mBegin;
+            Iterator mEnd;
+        };
+
+    public:
+        /// @brief Add a status, called by AsyncNETSGPClient for every valid status
+        void onStatus(const CompactStatus& status, const uint32_t timeMS) override
+        {
+            advanceClock(timeMS);
+
+            Series* series = findSeries(status.deviceID, true);
+            if (!series)
+            {
+                return;
+            }
+
+            const uint32_t acPower = status.acPowerRaw() / 1000; // 1/10000 W to 1/10 W
+            const uint16_t values[VALUES] = {static_cast<uint16_t>(acPower > 0xFFFF ? 0xFFFF : acPower),
+                status.dcVoltage, status.dcCurrent, status.temperature};
+
+            if (series->raw.size && mClockS - series->rawNewestS > 0xFFFF)
+            {
+                // Deltas can not span the gap, older raw samples are covered by the buckets anyway
+                series->raw.size = 0;
+            }
+            RawSample sample;
+            sample.deltaS = series->raw.size ? static_cast<uint16_t>(mClockS - series->rawNewestS) : 0;
+            memcpy(sample.values, values, sizeof(values));
+            series->raw.push(sample);
+            series->rawNewestS = mClockS;
+
+            series->minute.add(mClockS / periodS(TIER_MINUTE), values);
+            series->quarter.add(mClockS / periodS(TIER_QUARTER), values);
+        }
+
+        /// @brief Get all points of an inverter in a tier within a time range.
+        ///
+        /// Bucket tiers end with the bucket currently being filled.
+        /// @param deviceID The device identifier of the inverter
+        /// @param tier Tier to query
+        /// @param fromS Start of the range in seconds, see HistoryPoint::timeS
+        /// @param toS End of the range (inclusive) in seconds
+        /// @return Range Points in chronological order, empty if the inverter is unknown
+        Range query(const uint32_t deviceID, const HistoryTier tier, const uint32_t fromS = 0,
+            const uint32_t toS = 0xFFFFFFFF) const
+        {
+            const Series* series = const_cast<StatusHistory*>(this)->findSeries(deviceID, false);
+            if (!series)
+            {
+                return Range(Iterator(nullptr, tier, 0, 0), Iterator(nullptr, tier, 0, 0));
+            }
+
+            size_t count;
+            uint32_t timeS;
+            if (tier == TIER_RAW)
+            {
+                count = series->raw.size;
+                timeS = series->rawNewestS;
+                for (size_t i = 1; i < count; ++i)
+                {
+                    timeS -= series->raw.at(i).deltaS;
+                }
+            }
+            else
+            {
+                // Closed buckets are contiguous, the iterator moves to the time of the open bucket after them
+                const uint32_t period = periodS(tier);
+                const Tier<MinuteBuckets>& minute = series->minute;
+                const Tier<QuarterBuckets>& quarter = series->quarter;
+                const size_t closed = tier == TIER_MINUTE ? minute.ring.size : quarter.ring.size;
+                const uint32_t newest = tier == TIER_MINUTE ? minute.newest : quarter.newest;
+                const uint32_t open = tier == TIER_MINUTE ? minute.open.index : quarter.open.index;
+                count = closed + 1;
+                timeS = closed ? (newest + 1 - closed) * period : open * period;
+            }
+
+            Iterator begin(series, tier, 0, timeS);
+            size_t first = 0;
+            while (first < count && (*begin).timeS < fromS)
+            {
+                ++begin;
+                ++first;
+            }
+            Iterator end = begin;
+            size_t last = first;
+            while (last < count && (*end).timeS <= toS)
+            {
+                ++end;
+                ++last;
+            }
+            return Range(begin, end);
+        }
+
+        /// @brief Get the current time of the history in seconds, see HistoryPoint::timeS
+        uint32_t nowS() const { return mClockS; }
+
+        /// @brief Get the amount of inverters with a series
+        size_t inverterCount() const
+        {
+            size_t count = 0;
+            for (const Series& series : mSeries)
+            {
+                count += series.used;
+            }
+            return count;
+        }
+
+        /// @brief Remove all data
+        void clear()
+        {
+            for (Series& series : mSeries)
+            {
+                series.used = false;
+            }
+        }
+
+    private:
+        constexpr static uint32_t periodS(const HistoryTier tier)
+        {
+            return tier == TIER_MINUTE ? 60 : (tier == TIER_QUARTER ? 900 : 1);
+        }
+
+        /// @brief Advance the history clock, handles millis() overflow
+        void advanceClock(const uint32_t timeMS)
+        {
+            if (!mStarted)
+            {
+                mStarted = true;
+                mLastMS = timeMS;
+                return;
+            }
+            mRemainderMS += timeMS - mLastMS;
+            mLastMS = timeMS;
+            mClockS += mRemainderMS / 1000;
+            mRemainderMS %= 1000;
+        }
+
+        /// @brief Find the series of an inverter
+        ///
+        /// @param deviceID The device identifier of the inverter
+        /// @param create Assign a free series if none is found
+        /// @return Series* Found series or nullptr
+        Series* findSeries(const uint32_t deviceID, const bool create)
+        {
+            Series* free = nullptr;
+            for (Series& series : mSeries)
+            {
+                if (series.used && series.deviceID == deviceID)
+                {
+                    return &series;
+                }
+                if (!series.used && !free)
+                {
+                    free = &series;
+                }
+            }
+            if (!create || !free)
+            {
+                return nullptr;
+            }
+            memset(free, 0, sizeof(Series));
+            free->deviceID = deviceID;
+            free->used = true;
+            return free;
+        }
+
+    private:
+        Series mSeries[MaxInverters] = {}; /// One series per inverter
+        bool mStarted = false; /// Was the clock started
+        uint32_t mLastMS = 0; /// Time of the last status in milliseconds
+        uint32_t mRemainderMS = 0; /// Milliseconds not yet added to mClockS
+        uint32_t mClockS = 0; /// Seconds since the first status
+    };
+} // namespace NETSGP
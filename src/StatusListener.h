@@ -0,0 +1,20 @@
+#pragma once
+
+#include "StatusFrame.h"
+
+/// @brief NETSGP protocol specific stuff
+namespace NETSGP
+{
+    /// @brief Interface for components consuming every valid inverter status, e.g. history or energy accounting
+    class StatusListener
+    {
+    public:
+        virtual ~StatusListener() { }
+
+        /// @brief Called for every valid status, regardless of any change filter
+        ///
+        /// @param status Received status
+        /// @param timeMS Receive time in milliseconds
+        virtual void onStatus(const CompactStatus& status, const uint32_t timeMS) = 0;
+    };
+} // namespace NETSGP